@@ -55,6 +55,10 @@ PRICES_FILE_NAME = "prices.csv"
 ORDER_BOOK_FILE_NAME = "order_book.csv"
 TRADE_TICKS_FILE_NAME = "trade_ticks.csv"
 
+# tables written by 2024_src/post_trade.cc, which does the preprocessing below ahead of time
+ORDER_BOOK_ETF_FILE_NAME = "order_book_etf.csv"
+TRADE_TICKS_ETF_FILE_NAME = "trade_ticks_etf.csv"
+
 
 class Tab:
     # build the plots that won't be updated during runtime
@@ -117,6 +121,14 @@ class Tab:
 
             return total_price / total_vol if total_vol != 0 else pd.NA
 
+        # if post_trade has been run over the logs, load its tables rather than building our own
+        order_book_etf_path = os.path.join(custom_log_path, ORDER_BOOK_ETF_FILE_NAME)
+        trade_ticks_etf_path = os.path.join(custom_log_path, TRADE_TICKS_ETF_FILE_NAME)
+        if os.path.exists(order_book_etf_path) and os.path.exists(trade_ticks_etf_path):
+            self.order_book_data = pd.read_csv(order_book_etf_path)
+            self.trade_ticks = pd.read_csv(trade_ticks_etf_path)
+            return
+
         # get orderbook
         try:
             self.order_book_data = pd.read_csv(os.path.join(custom_log_path, ORDER_BOOK_FILE_NAME))
@@ -0,0 +1,208 @@
+#ifndef READY_TRADER_GO_2024_ANALYTICS_H
+#define READY_TRADER_GO_2024_ANALYTICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <ready_trader_go/types.h>
+#include "concurrency.h"
+#include "data_handling.h"
+#include "logger.h"
+#include "mids.h"
+
+/* Work that the trader doesn't need to quote (logging, and scoring our fair value against trade ticks) is handed
+ * off to an analytics thread. The trading thread pushes compact events onto an SPSC queue and carries on; anything
+ * the trading thread wants back is published as an AnalyticsSnapshot. */
+
+enum class AnalyticsEventType : std::uint8_t {
+    OrderBook, TradeTicks, OrderSent, OrderCancelled, OrderFilled
+};
+
+struct AnalyticsEvent {
+    AnalyticsEventType type;
+    Instrument instrument;
+    Side side;
+    double time;
+    unsigned long clientOrderID;
+    long volume, price;
+    double fairValue, projectedFairValue;
+    std::array<unsigned long, TOP_LEVEL_COUNT> askPrices, askVolumes, bidPrices, bidVolumes;
+};
+
+struct AnalyticsSnapshot {
+    double fairValueScore = 0; // average distance of trades from our fair value, see MidMetrics
+    long long tradesScored = 0;
+};
+
+class AnalyticsPipeline {
+public:
+    AnalyticsPipeline(Logger *loggerIn): logger(loggerIn) {
+        midMetrics.add(fairValueName, &fairValues);
+        midMetrics.add(projectedFairValueName, &projectedFairValues);
+        worker = std::thread([this] { run(); });
+    }
+    ~AnalyticsPipeline() {
+        running.store(false, std::memory_order_release);
+        worker.join();
+    }
+    AnalyticsPipeline(const AnalyticsPipeline&) = delete;
+    AnalyticsPipeline &operator=(const AnalyticsPipeline&) = delete;
+
+    /* Called on the trading thread */
+    void orderBook(double time, Instrument instrument, double fairValue, double projectedFairValue,
+                   const std::array<unsigned long, TOP_LEVEL_COUNT> &askPrices,
+                   const std::array<unsigned long, TOP_LEVEL_COUNT> &askVolumes,
+                   const std::array<unsigned long, TOP_LEVEL_COUNT> &bidPrices,
+                   const std::array<unsigned long, TOP_LEVEL_COUNT> &bidVolumes) {
+        AnalyticsEvent event = makeEvent(AnalyticsEventType::OrderBook, time, instrument);
+        event.fairValue = fairValue;
+        event.projectedFairValue = projectedFairValue;
+        event.askPrices = askPrices;
+        event.askVolumes = askVolumes;
+        event.bidPrices = bidPrices;
+        event.bidVolumes = bidVolumes;
+        publish(event);
+    }
+    void tradeTicks(double time, Instrument instrument,
+                    const std::array<unsigned long, TOP_LEVEL_COUNT> &askPrices,
+                    const std::array<unsigned long, TOP_LEVEL_COUNT> &askVolumes,
+                    const std::array<unsigned long, TOP_LEVEL_COUNT> &bidPrices,
+                    const std::array<unsigned long, TOP_LEVEL_COUNT> &bidVolumes) {
+        AnalyticsEvent event = makeEvent(AnalyticsEventType::TradeTicks, time, instrument);
+        event.askPrices = askPrices;
+        event.askVolumes = askVolumes;
+        event.bidPrices = bidPrices;
+        event.bidVolumes = bidVolumes;
+        publish(event);
+    }
+    void orderSent(double time, Instrument instrument, Side side, unsigned long clientOrderID, long volume, long price) {
+        AnalyticsEvent event = makeEvent(AnalyticsEventType::OrderSent, time, instrument);
+        event.side = side;
+        event.clientOrderID = clientOrderID;
+        event.volume = volume;
+        event.price = price;
+        publish(event);
+    }
+    void orderCancelled(double time, Instrument instrument, unsigned long clientOrderID, Side side) {
+        AnalyticsEvent event = makeEvent(AnalyticsEventType::OrderCancelled, time, instrument);
+        event.side = side;
+        event.clientOrderID = clientOrderID;
+        publish(event);
+    }
+    void orderFilled(double time, Instrument instrument, Side side, unsigned long clientOrderID, long fillVolume, long price) {
+        AnalyticsEvent event = makeEvent(AnalyticsEventType::OrderFilled, time, instrument);
+        event.side = side;
+        event.clientOrderID = clientOrderID;
+        event.volume = fillVolume;
+        event.price = price;
+        publish(event);
+    }
+
+    AnalyticsSnapshot getSnapshot() const {
+        return snapshot.read();
+    }
+    unsigned long getStalls() const {
+        /* times the trading thread had to wait because the analytics thread had fallen a whole queue behind */
+        return stalls;
+    }
+
+    void drain() {
+        /* waits until the analytics thread has handled everything we've published. Once this returns, and until the
+         * next event is published, the trading thread may safely touch the analytics state (e.g. to checkpoint it) */
+        while (processed.load(std::memory_order_acquire) != published) std::this_thread::yield();
+    }
+    std::thread &getWorker() {
+        return worker;
+    }
+    MidMetrics &getMidMetrics() {
+        /* only safe after drain() */
+        return midMetrics;
+    }
+private:
+    static constexpr std::size_t queueSize = 1 << 14;
+    const std::string fairValueName = "InverseVWAP";
+    const std::string projectedFairValueName = "InverseVWAP + lead-lag projection"; // scored, but not yet quoted around
+
+    // only touched by the analytics thread
+    Logger *logger;
+    // MidMetrics only scores trades against the latest of each, so that's all we keep, however long the session
+    static constexpr std::size_t fairValuesKept = 1;
+    MarketStream fairValues = MarketStream(fairValuesKept); // the latest ETF fair value
+    MarketStream projectedFairValues = MarketStream(fairValuesKept); // and projected forward from recent futures moves, see LeadLagEstimator
+    MidMetrics midMetrics;
+
+    SpscQueue<AnalyticsEvent, queueSize> queue;
+    Published<AnalyticsSnapshot> snapshot;
+    unsigned long published = 0, stalls = 0; // trading thread only
+    std::atomic<unsigned long> processed = 0;
+    std::atomic<bool> running = true;
+    std::thread worker;
+
+    static AnalyticsEvent makeEvent(AnalyticsEventType type, double time, Instrument instrument) {
+        AnalyticsEvent event;
+        std::memset(&event, 0, sizeof(event));
+        event.type = type;
+        event.time = time;
+        event.instrument = instrument;
+        return event;
+    }
+    void publish(const AnalyticsEvent &event) {
+        /* the logs are what we analyse sessions with, so rather than drop an event we wait for space. This only happens
+         * if the analytics thread is a whole queue behind, where before we'd have been doing the logging ourselves */
+        if (!queue.tryPush(event)) {
+            stalls ++;
+            while (!queue.tryPush(event)) std::this_thread::yield();
+        }
+        published ++;
+    }
+    void run() {
+        AnalyticsEvent event;
+        while (true) {
+            bool stopping = !running.load(std::memory_order_acquire);
+            bool handledAny = false;
+            while (queue.tryPop(event)) {
+                handle(event);
+                processed.fetch_add(1, std::memory_order_release);
+                handledAny = true;
+            }
+            if (stopping) break;
+            if (!handledAny) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    void handle(const AnalyticsEvent &event) {
+        switch (event.type) {
+            case AnalyticsEventType::OrderBook:
+                logger->logPrice(event.time, event.instrument, event.fairValue);
+                logger->logOrderbook(event.time, event.instrument, event.askPrices, event.askVolumes,
+                                     event.bidPrices, event.bidVolumes, event.fairValue);
+                if (event.instrument == Instrument::ETF) {
+                    fairValues.push(event.fairValue);
+                    projectedFairValues.push(event.projectedFairValue);
+                }
+                break;
+            case AnalyticsEventType::TradeTicks: {
+                logger->logTradeTicks(event.time, event.instrument, event.askPrices, event.askVolumes,
+                                      event.bidPrices, event.bidVolumes);
+                midMetrics.onTradeTicks(event.instrument, event.askPrices, event.askVolumes, event.bidPrices, event.bidVolumes);
+
+                AnalyticsSnapshot latest;
+                latest.tradesScored = midMetrics.getTotalTrades();
+                latest.fairValueScore = midMetrics.getScore(fairValueName);
+                snapshot.publish(latest);
+                break;
+            }
+            case AnalyticsEventType::OrderSent:
+                logger->orderSent(event.time, event.instrument, event.side, event.clientOrderID, event.volume, event.price);
+                break;
+            case AnalyticsEventType::OrderCancelled:
+                logger->orderCancelled(event.time, event.instrument, event.clientOrderID, event.side);
+                break;
+            case AnalyticsEventType::OrderFilled:
+                logger->orderFilled(event.time, event.instrument, event.side, event.clientOrderID, event.volume, event.price);
+                break;
+        }
+    }
+};
+
+#endif //READY_TRADER_GO_2024_ANALYTICS_H
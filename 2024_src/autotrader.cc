@@ -15,31 +15,80 @@ RTG_INLINE_GLOBAL_LOGGER_WITH_CHANNEL(LG_AT, "AUTO")
 AutoTrader::AutoTrader(boost::asio::io_context& context) : BaseAutoTrader(context)
 {
     // Set the etfStream to be calculated by an inverseVWAP
-    inverseVwapEstimator.setStream(&etfPriceHistory);
+    inverseVwapEstimator.setStream(&history->etfPriceHistory);
+
+    // strategies to run alongside ours
+    if (hostAlternatives) hostStrategy("Priority", std::make_unique<PriorityQuoter>(), 0.25);
 
     // set the speed of the frequency limiter
-    frequencyLimiter.setSpeed(4); //todo: remember this exists
+    frequencyLimiter.setSpeed(params->messageSpeed);
+    volumeImbalance.setThreshold(params->imbalanceThreshold / 100.0);
+    riskGate.setLimits(TradingParameters::positionLimit, params->combinedPositionLimit, params->maxLotsPerSecond, params->priceBand);
+
+    // pick up where we left off, before we journal anything, so the journal carries on from the checkpoint
+    bool resumed = warmStart && !SessionJournal::replaying() && loadCheckpoint(checkpointPrefix + "latest.bin");
+    if (resumed) resumeFromCheckpoint();
+
+    // the parameters we start with, so a replay starts with them too
+    journal.recordParams(paramStore.getPath(), *params);
+    for (std::unique_ptr<HostedStrategy> &hosted: hostedStrategies) {
+        hosted->adopted = hosted->params.enter();
+        journal.recordParams(hosted->params.getPath(), *hosted->adopted);
+    }
+
+    // this session's journal doesn't hold what came before the restart, so its replays start from here
+    if (resumed) saveCheckpoint(checkpointPrefix + "warm_" + std::to_string(hot.currSequenceNumber) + ".bin");
 }
 void AutoTrader::DisconnectHandler()
 {
+    HandlerScope scope(*this);
+    hot.eventTime = journal.recordDisconnect();
+    refreshParams();
     BaseAutoTrader::DisconnectHandler();
     metrics.outputMetrics();
+    if (showMetrics) {
+        orderLifecycle.print();
+        leadLag.print();
+        bookDiff.print();
+        riskGate.print();
+        outbound.print();
+        analytics.drain();
+        analytics.getMidMetrics().printMetrics();
+    }
+    profiler.print();
     debugPrint(); // dump status upon disconnect
+    if (analytics.getStalls() > 0)
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "waited on the analytics thread " << analytics.getStalls() << " times";
+    if (journal.getDropped() > 0)
+        RLOG(LG_AT, LogLevel::LL_WARNING) << journal.getDropped() << " journal records dropped, this session can't be replayed exactly";
     RLOG(LG_AT, LogLevel::LL_INFO) << "execution connection lost";
 }
 void AutoTrader::ErrorMessageHandler(unsigned long clientOrderId, const std::string& errorMessage)
 {
+    HandlerScope scope(*this);
+    hot.eventTime = journal.recordError(clientOrderId, errorMessage);
+    refreshParams();
     RLOG(LG_AT, LogLevel::LL_INFO) << "error with order " << clientOrderId << ": " << errorMessage;
     if (clientOrderId != 0) orderClosed(clientOrderId);
 }
 void AutoTrader::HedgeFilledMessageHandler(unsigned long clientOrderId, unsigned long price, unsigned long volume)
 {
+    ProfileScope profile(profiler, ProfiledHandler::HedgeFilled);
+    HandlerScope scope(*this);
+    hot.eventTime = journal.recordFill(JournalEvent::HedgeFilled, clientOrderId, price, volume);
+    refreshParams();
     orderFilled(clientOrderId, price, volume);
+    // hedges are fill and kill, so whatever didn't fill is gone
+    orderClosed(clientOrderId);
     RLOG(LG_AT, LogLevel::LL_INFO) << "hedge order " << clientOrderId << " filled for " << volume
                                    << " lots at $" << price << " average price in cents";
 }
 void AutoTrader::OrderFilledMessageHandler(unsigned long clientOrderId, unsigned long price, unsigned long volume)
 {
+    ProfileScope profile(profiler, ProfiledHandler::OrderFilled);
+    HandlerScope scope(*this);
+    hot.eventTime = journal.recordFill(JournalEvent::OrderFilled, clientOrderId, price, volume);
+    refreshParams();
     orderFilled(clientOrderId, price, volume);
     RLOG(LG_AT, LogLevel::LL_INFO) << "order " << clientOrderId << " filled for " << volume
                                    << " lots at $" << price << " cents";
@@ -47,25 +96,26 @@ void AutoTrader::OrderFilledMessageHandler(unsigned long clientOrderId, unsigned
 }
 void AutoTrader::OrderStatusMessageHandler(unsigned long clientOrderId, unsigned long fillVolume, unsigned long remainingVolume, signed long fees)
 {
+    ProfileScope profile(profiler, ProfiledHandler::OrderStatus);
+    HandlerScope scope(*this);
+    hot.eventTime = journal.recordStatus(clientOrderId, fillVolume, remainingVolume, fees);
+    refreshParams();
+    orderLifecycle.statusReceived(clientOrderId, hot.eventTime);
     //todo: get fees from here
     if (remainingVolume == 0) orderClosed(clientOrderId);
 }
 
 /* Utility functions */
 bool AutoTrader::sendOrder(std::string name, Instrument instrument, ReadyTraderGo::Side side, long size, long price) {
-    if (!frequencyLimiter.sendMessage()) return false;
+    if (!frequencyLimiter.sendMessage(hot.eventTime)) return false;
 
     /* Validate the order */
     if ((price > ReadyTraderGo::MAXIMUM_ASK) || (price < ReadyTraderGo::MINIMUM_BID)) {
         RLOG(LG_AT, LogLevel::LL_ERROR) << "Order sent at invalid price " << price;
         return false;
     }
-    long marketExposure = instrument == Instrument::ETF ? allEtfBooks.getExposure() : allFutureBooks.getExposure();
-    long marketBids = instrument == Instrument::ETF ? allEtfBooks.getSubmittedBids()  : allFutureBooks.getSubmittedBids();
-    long marketAsks = instrument == Instrument::ETF ? allEtfBooks.getSubmitedAsks() : allFutureBooks.getSubmitedAsks();
-    size = side == Side::BUY
-            ? std::min(size, TradingParameters::positionLimit - marketExposure - marketBids)
-            : std::min(size, marketExposure - marketAsks + TradingParameters::positionLimit);
+    bool reducesExposure = riskGate.reducesExposure(instrument, side, size);
+    size = reducesExposure ? riskGate.getAllowedHedgeSize(side, size) : riskGate.getAllowedSize(instrument, side, size, hot.eventTime);
 
     if (size <= 0) {
         RLOG(LG_AT, LogLevel::LL_ERROR) << "Order sent for zero lots " << price;
@@ -76,54 +126,95 @@ bool AutoTrader::sendOrder(std::string name, Instrument instrument, ReadyTraderG
     /* Round the price to the tick size */
     constexpr long tickSize = 100;
     price = ((long) ((price + tickSize / 2) / tickSize)) * tickSize;
+    if (!reducesExposure && !riskGate.inBand(price)) {
+        RLOG(LG_AT, LogLevel::LL_ERROR) << "Order sent at " << price << ", too far from the fair value";
+        return false;
+    }
+    riskGate.onSend(instrument, side, size, price, hot.eventTime);
 
     /* Send the order */
     if (instrument == Instrument::ETF) {
         allEtfBooks.sendOrder(name, Instrument::ETF, side, size, price);
 
-        SendInsertOrder(idGen.getCurrent(), side, price, size, ReadyTraderGo::Lifespan::GOOD_FOR_DAY);
+        exchangeInsertOrder(idGen.getCurrent(), side, price, size);
     } else {
         allFutureBooks.sendOrder(name, Instrument::FUTURE, side, size, price);
 
-        SendHedgeOrder(idGen.getCurrent(), side, (long) price, size);
+        exchangeHedgeOrder(idGen.getCurrent(), side, price, size);
     }
 
+    syncPosition();
+
     /* Log the order */
-    logger.orderSent(time.getTime(), instrument, side, idGen.getCurrent(), size, price);
+    orderLifecycle.orderSent(idGen.getCurrent(), instrument, side, price, size, hot.lastQuotedMid, hot.eventTime);
+    analytics.orderSent(time.getTime(), instrument, side, idGen.getCurrent(), size, price);
     RLOG(LG_AT, LogLevel::LL_INFO) << side << " order " << idGen.getCurrent() << " sent at " << price << " for " << size << " lots in " << instrument;
 
     return true;
 }
 bool AutoTrader::cancelOrder(unsigned long clientOrderID) {
-    if (!frequencyLimiter.sendMessage()) return false;
+    if (!frequencyLimiter.sendMessage(hot.eventTime)) return false;
 
     /* Send the cancel order to the exchange */
-    SendCancelOrder(clientOrderID);
+    exchangeCancelOrder(clientOrderID);
 
     /* Send the cancel order internally */
     allEtfBooks.cancelOrder(clientOrderID);
     allFutureBooks.cancelOrder(clientOrderID);
 
     /* Log it */
-    logger.orderCancelled(time.getTime(), Instrument::ETF, clientOrderID, Side::BUY);
+    orderLifecycle.cancelSent(clientOrderID, hot.eventTime);
+    analytics.orderCancelled(time.getTime(), Instrument::ETF, clientOrderID, Side::BUY);
     RLOG(LG_AT, LogLevel::LL_INFO) << "Order " << clientOrderID << " canceled.";
     return true;
 }
+void AutoTrader::exchangeInsertOrder(unsigned long clientOrderID, Side side, unsigned long price, unsigned long size) {
+    outbound.stage({JournalEvent::InsertOrder, clientOrderID, side, price, size});
+}
+void AutoTrader::exchangeHedgeOrder(unsigned long clientOrderID, Side side, unsigned long price, unsigned long size) {
+    outbound.stage({JournalEvent::HedgeOrder, clientOrderID, side, price, size});
+}
+void AutoTrader::exchangeCancelOrder(unsigned long clientOrderID) {
+    outbound.stage({JournalEvent::CancelOrder, clientOrderID, Side::BUY, 0, 0});
+}
+void AutoTrader::flushOutbound() {
+    /* Journals and sends everything staged, in the order it leaves, so a replay stages and flushes it identically */
+    bool live = !SessionJournal::replaying();
+    outbound.flush([&] (const OutboundMessage &message) {
+        switch (message.type) {
+            case JournalEvent::InsertOrder:
+                journal.recordInsert(message.clientOrderID, message.side, message.price, message.size, ReadyTraderGo::Lifespan::GOOD_FOR_DAY);
+                if (live) SendInsertOrder(message.clientOrderID, message.side, message.price, message.size, ReadyTraderGo::Lifespan::GOOD_FOR_DAY);
+                break;
+            case JournalEvent::HedgeOrder:
+                journal.recordHedge(message.clientOrderID, message.side, message.price, message.size);
+                if (live) SendHedgeOrder(message.clientOrderID, message.side, message.price, message.size);
+                break;
+            default:
+                journal.recordCancel(message.clientOrderID);
+                if (live) SendCancelOrder(message.clientOrderID);
+        }
+    });
+}
 void AutoTrader::orderFilled(unsigned long clientOrderID, long price, long fillVolume) {
     // find the order before we fill it
     std::optional<Order> etfOptional = allEtfBooks.findOrder(clientOrderID);
     std::optional<Order> futuresOptional = allFutureBooks.findOrder(clientOrderID);
 
     // fill it
+    reactionTable.invalidate();
+    orderLifecycle.filled(clientOrderID, fillVolume, hot.eventTime);
     allEtfBooks.orderFilled(clientOrderID, price, fillVolume);
     allFutureBooks.orderFilled(clientOrderID, price, fillVolume);
+    syncPosition();
 
     // find which orderbook its from
     if (!(etfOptional.has_value() || futuresOptional.has_value())) return;
     Order order = etfOptional.has_value() ? etfOptional.value() : futuresOptional.value();
+    riskGate.onFill(order.instrument, order.side, fillVolume);
 
     // log the order
-    logger.orderFilled(time.getTime(), order.instrument, order.side, order.clientOrderID, fillVolume, price);
+    analytics.orderFilled(time.getTime(), order.instrument, order.side, order.clientOrderID, fillVolume, price);
 
     // hedge if we've taken on ETF exposure
     if (order.instrument == Instrument::FUTURE) return;
@@ -132,8 +223,189 @@ void AutoTrader::orderFilled(unsigned long clientOrderID, long price, long fillV
     hedge();
 }
 void AutoTrader::orderClosed(unsigned long clientOrderID) {
+    reactionTable.invalidate();
+    orderLifecycle.closed(clientOrderID, hot.eventTime);
+    std::optional<Order> order = allEtfBooks.findOrder(clientOrderID);
+    if (!order.has_value()) order = allFutureBooks.findOrder(clientOrderID);
+    if (order.has_value()) riskGate.onClose(order->instrument, order->side, order->size);
     allEtfBooks.orderClosed(clientOrderID);
     allFutureBooks.orderClosed(clientOrderID);
+    syncPosition();
+}
+void AutoTrader::resumeFromCheckpoint() {
+    /* Carries on from a checkpoint an earlier process wrote. Its times are on that process's clock, which after a
+     * reboot may be well ahead of ours, so we move our time windows onto our clock as if we'd restarted at once */
+    std::int64_t now = SessionJournal::clockTime();
+    frequencyLimiter.rebase(hot.eventTime, now);
+    riskGate.rebase(hot.eventTime, now);
+    hot.eventTime = now;
+    dropRestoredOrders();
+}
+void AutoTrader::dropRestoredOrders() {
+    /* The exchange cancelled our resting orders when we disconnected, so after a warm start, forget the ones the
+     * checkpoint restored, and the open volume they hold in the books and the risk gate */
+    std::vector<unsigned long> restored;
+    for (BooksContainer *books: {&allEtfBooks, &allFutureBooks}) {
+        for (auto &pair: books->getBids()) restored.push_back(pair.first);
+        for (auto &pair: books->getAsks()) restored.push_back(pair.first);
+    }
+    for (unsigned long clientOrderID: restored) orderClosed(clientOrderID);
+    requoteCache.invalidate();
+    if (!restored.empty()) RLOG(LG_AT, LogLevel::LL_INFO) << "dropped " << restored.size() << " orders the exchange cancelled while we were away";
+}
+void AutoTrader::syncPosition() {
+    /* copies what the tick path reads of our position into the hot state */
+    hot.etfPosition = allEtfBooks.getExposure();
+    hot.futurePosition = allFutureBooks.getExposure();
+    hot.quotedBids = primaryBook->submittedBids;
+    hot.quotedAsks = primaryBook->submittedAsks;
+    hot.ordersVersion = allEtfBooks.getVersion();
+}
+void AutoTrader::publishTelemetry() {
+    double networth = allEtfBooks.getDummyCash() + allFutureBooks.getDummyCash() +
+                      (double) hot.lastFutureMid * (hot.etfPosition + hot.futurePosition);
+    TelemetrySnapshot snapshot;
+    snapshot.time = time.getTime();
+    snapshot.sequenceNumber = hot.currSequenceNumber;
+    snapshot.etfPosition = hot.etfPosition;
+    snapshot.futurePosition = hot.futurePosition;
+    snapshot.networth = networth;
+    snapshot.lotsFilled = allEtfBooks.getLotsFilled() + allFutureBooks.getLotsFilled();
+    snapshot.ordersSent = allEtfBooks.getOrdersSent() + allFutureBooks.getOrdersSent();
+    snapshot.ordersCancelled = allEtfBooks.getOrdersCancelled() + allFutureBooks.getOrdersCancelled();
+    snapshot.liveOrders = allEtfBooks.getLiveOrders() + allFutureBooks.getLiveOrders();
+    snapshot.submittedBids = allEtfBooks.getSubmittedBids();
+    snapshot.submittedAsks = allEtfBooks.getSubmitedAsks();
+    snapshot.limiterUtilisation = frequencyLimiter.getUtilisation();
+    snapshot.latencyP50 = bookLatency.percentile(0.5);
+    snapshot.latencyP90 = bookLatency.percentile(0.9);
+    snapshot.latencyP99 = bookLatency.percentile(0.99);
+    snapshot.bidQuote = hot.lastBidQuote;
+    snapshot.askQuote = hot.lastAskQuote;
+    snapshot.fairValueScore = analytics.getSnapshot().fairValueScore;
+    telemetry.publish(snapshot);
+}
+void AutoTrader::refreshParams() {
+    /* Picks up the latest parameters. If they've been reloaded, anything computed with the old ones is stale */
+    const StrategyParams *latest = paramStore.enter();
+    if (latest == params) return;
+
+    params = latest;
+    journal.recordParams(paramStore.getPath(), *params);
+    frequencyLimiter.setSpeed(params->messageSpeed);
+    volumeImbalance.setThreshold(params->imbalanceThreshold / 100.0);
+    riskGate.setLimits(TradingParameters::positionLimit, params->combinedPositionLimit, params->maxLotsPerSecond, params->priceBand);
+    reactionTable.invalidate();
+    priorityPricesCache.invalidate();
+    requoteCache.invalidate();
+    RLOG(LG_AT, LogLevel::LL_INFO) << "now trading with parameters generation " << params->generation;
+}
+void AutoTrader::pinHelperThreads(int core) {
+    /* keeps the analytics, journal and parameter watcher threads off the trading core */
+    if (!pinThread(analytics.getWorker().native_handle(), core))
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "couldn't pin the analytics thread to core " << core;
+    if (journal.getWriter().joinable() && !pinThread(journal.getWriter().native_handle(), core))
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "couldn't pin the journal thread to core " << core;
+    std::vector<StrategyParamStore*> stores = {&paramStore};
+    for (std::unique_ptr<HostedStrategy> &hosted: hostedStrategies) stores.push_back(&hosted->params);
+    for (StrategyParamStore *store: stores) {
+        if (store->getWatcher().joinable() && !pinThread(store->getWatcher().native_handle(), core))
+            RLOG(LG_AT, LogLevel::LL_WARNING) << "couldn't pin the watcher of " << store->getPath() << " to core " << core;
+    }
+}
+void AutoTrader::replayParams(const JournalRecord &record) {
+    /* Publishes a block of parameters the session adopted, to the store it came from. The trader picks it up at the
+     * start of the next callback, as it did live */
+    std::string path(record.message);
+    if (path == paramStore.getPath()) paramStore.publish(readParams(record));
+    for (std::unique_ptr<HostedStrategy> &hosted: hostedStrategies)
+        if (path == hosted->params.getPath()) hosted->params.publish(readParams(record));
+}
+void AutoTrader::warmUp() {
+    /* Allocates up front what the tick path would otherwise allocate on its first few ticks */
+    static const long maxLiveOrders = 64;
+    reactionTable.reserve(maxLiveOrders);
+    outbound.reserve(maxLiveOrders);
+
+    // touch the hot state so its cache line is ours before the first message
+    volatile long touch = hot.currSequenceNumber + hot.lastQuotedMid;
+    (void) touch;
+}
+bool AutoTrader::saveCheckpoint(const std::string &path) {
+    /* Writes a checkpoint straight away, on this thread */
+    CheckpointWriter writer;
+    serialiseCheckpoint(writer);
+    bool saved = writer.writeToFile(path);
+    if (!saved) RLOG(LG_AT, LogLevel::LL_ERROR) << "failed to write checkpoint " << path;
+    return saved;
+}
+void AutoTrader::checkpoint() {
+    /* Serialises a checkpoint, and leaves writing it to the journal's writer thread */
+    CheckpointWriter writer;
+    serialiseCheckpoint(writer);
+    std::string path = checkpointPrefix + std::to_string(hot.currSequenceNumber) + ".bin";
+    if (!journal.writeCheckpoint(writer.release(), path, checkpointPrefix + "latest.bin")) {
+        // we aren't journaling, so there's no writer thread. Just keep the latest
+        saveCheckpoint(checkpointPrefix + "latest.bin");
+    }
+}
+void AutoTrader::serialiseCheckpoint(CheckpointWriter &writer) {
+    /* Writes out everything our future behaviour depends on. Caches that are always recomputed identically, and the
+     * exchange book queues, aren't saved */
+    writer.write(hot);
+    writer.write(journal.getNextIndex());
+    writer.write(lastCheckpointTime);
+    time.save(writer);
+    idGen.save(writer);
+    frequencyLimiter.save(writer);
+    allEtfBooks.save(writer);
+    allFutureBooks.save(writer);
+    matchingEngine.save(writer);
+    volumeImbalance.save(writer);
+    leadLag.save(writer);
+    tradeBars.save(writer);
+    bookDiff.save(writer);
+    riskGate.save(writer);
+    for (MarketStream *stream: {&history->etfPriceHistory, &history->futuresPriceHistory, &history->networthHistory,
+                                &history->spreadHistory, &history->bidPriceHistory, &history->askPriceHistory})
+        stream->save(writer);
+    analytics.drain(); // so we can read the analytics thread's state
+    analytics.getMidMetrics().save(writer);
+    requoteCache.save(writer);
+}
+bool AutoTrader::loadCheckpoint(const std::string &path) {
+    /* Restores the state written by saveCheckpoint */
+    CheckpointReader reader(path);
+    if (!reader.isOk()) {
+        RLOG(LG_AT, LogLevel::LL_ERROR) << "no valid checkpoint at " << path;
+        return false;
+    }
+
+    reader.read(hot);
+    journal.setNextIndex(reader.read<std::uint64_t>());
+    reader.read(lastCheckpointTime);
+    time.load(reader);
+    idGen.load(reader);
+    frequencyLimiter.load(reader);
+    allEtfBooks.load(reader);
+    allFutureBooks.load(reader);
+    matchingEngine.load(reader);
+    volumeImbalance.load(reader);
+    leadLag.load(reader);
+    tradeBars.load(reader);
+    bookDiff.load(reader);
+    riskGate.load(reader);
+    for (MarketStream *stream: {&history->etfPriceHistory, &history->futuresPriceHistory, &history->networthHistory,
+                                &history->spreadHistory, &history->bidPriceHistory, &history->askPriceHistory})
+        stream->load(reader);
+    analytics.drain();
+    analytics.getMidMetrics().load(reader);
+    requoteCache.load(reader);
+    reactionTable.invalidate();
+
+    if (!reader.isOk()) RLOG(LG_AT, LogLevel::LL_ERROR) << "checkpoint " << path << " was truncated";
+    else RLOG(LG_AT, LogLevel::LL_INFO) << "restored checkpoint " << path << " at time " << time.getTime();
+    return reader.isOk();
 }
 /* ######################################################################## */
 /* UTILITY METHODS END */
@@ -148,40 +420,70 @@ void AutoTrader::OrderBookMessageHandler(Instrument instrument,
                                          const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
                                          const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
 {
+    ProfileScope profile(profiler, ProfiledHandler::OrderBook);
+    HandlerScope scope(*this);
+    auto handlerStart = std::chrono::steady_clock::now();
+    hot.eventTime = journal.recordBook(JournalEvent::OrderBook, instrument, sequenceNumberIn, askPrices, askVolumes, bidPrices, bidVolumes);
+    refreshParams();
+
     /* Advance time */
-    if (sequenceNumberIn != currSequenceNumber) {
+    if (sequenceNumberIn != hot.currSequenceNumber) {
         time.advanceTime(0.25); // we receive a set of books
-        currSequenceNumber = sequenceNumberIn;
+        hot.currSequenceNumber = sequenceNumberIn;
         assert(instrument != Instrument::ETF); // we should always get the future books first
     }
 
     /* Store the order book */
     ExchangeOrderBookData exchangeBook = ExchangeOrderBookData(askPrices, askVolumes, bidPrices, bidVolumes);
-    if (instrument == Instrument::ETF) {
-        etfExchangeOrderBookData.push(exchangeBook);
-    } else {
-        futureExchangeOrderBookData.push(exchangeBook);
-    }
+    history->pushBook(instrument, exchangeBook);
+    if (instrument == Instrument::FUTURE) {
+        hot.lastFutureMid = exchangeBook.getMid();
+        if ((askPrices[0] != 0) && (bidPrices[0] != 0)) riskGate.setFairValue(hot.lastFutureMid);
+    } else orderLifecycle.onOrderBook(askPrices, askVolumes, bidPrices, bidVolumes);
+    volumeImbalance.onOrderBook(instrument, askVolumes, bidVolumes);
+    bookDiff.onOrderBook(instrument, askPrices, askVolumes, bidPrices, bidVolumes);
 
     /* Calculate the fair value */
-    std::optional<long> inverseVWAPMid = inverseVwapEstimator.calculateMid(askPrices, askVolumes, bidPrices, bidVolumes);
+    std::optional<long> inverseVWAPMid = inverseVwapEstimator.calculateMid(instrument, askPrices, askVolumes, bidPrices, bidVolumes);
     std::optional<long> bookMid = inverseVWAPMid; // use the inverseVWAP as the fair value
     if (!bookMid.has_value()) return;
 
+    /* Project the ETF's fair value forward from futures moves it hasn't caught up with yet */
+    double projectedMid = bookMid.value();
+    if (instrument == Instrument::ETF) {
+        leadLag.onSequence(hot.lastFutureMid, bookMid.value());
+        projectedMid += leadLag.getProjection();
+    }
+
     /* Store the fair value, and orderbook */
-    logger.logPrice(time.getTime(), instrument, bookMid.value());
-    logger.logOrderbook(time.getTime(), instrument, askPrices, askVolumes, bidPrices, bidVolumes, bookMid.value());
+    analytics.orderBook(time.getTime(), instrument, bookMid.value(), projectedMid, askPrices, askVolumes, bidPrices, bidVolumes);
 
-    /* Now break if this isn't an ETF book */
-    if (instrument == Instrument::FUTURE) return;
+    /* On a futures book, requote straight away if the move made our ETF quotes stale */
+    if (instrument == Instrument::FUTURE) {
+        onFutureMidMove(hot.lastFutureMid);
+        return;
+    }
 
     /* Make the market */
-    long futureMid = futureExchangeOrderBookData.back().getMid(); // quote our prices around the mid of the futures
+    long futureMid = hot.lastFutureMid; // quote our prices around the mid of the futures
     makeMarket(futureMid, askPrices, askVolumes, bidPrices, bidVolumes);
+    if (!hostedStrategies.empty())
+        runHostedStrategies({time.getTime(), futureMid, bookMid.value(), askPrices, askVolumes, bidPrices, bidVolumes});
 
     /* Store our networth */
-    float networth = allEtfBooks.getDummyCash() + allFutureBooks.getDummyCash() + futureMid * (allEtfBooks.getExposure() + allFutureBooks.getExposure());
-    networthHistory.push(networth);
+    float networth = allEtfBooks.getDummyCash() + allFutureBooks.getDummyCash() + futureMid * (hot.etfPosition + hot.futurePosition);
+    history->networthHistory.push(networth);
+
+    bookLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - handlerStart).count());
+
+    /* Checkpoint every so often. This must come last, so the checkpoint holds everything this book changed, and
+     * what we sent is journaled before it */
+    static const double checkpointInterval = 60;
+    if (useCheckpoints && !SessionJournal::replaying() && (time.getTime() - lastCheckpointTime >= checkpointInterval)) {
+        flushOutbound();
+        lastCheckpointTime = time.getTime();
+        checkpoint();
+    }
 }
 void AutoTrader::TradeTicksMessageHandler(Instrument instrument,
                                           unsigned long sequenceNumber,
@@ -190,25 +492,38 @@ void AutoTrader::TradeTicksMessageHandler(Instrument instrument,
                                           const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
                                           const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
 {
-    /* Log the trade ticks, and use them to evaluate mid calculations */
-    logger.logTradeTicks(time.getTime(), instrument, askPrices, askVolumes, bidPrices, bidVolumes);
-    midMetrics.onTradeTicks(instrument, askPrices, askVolumes, bidPrices, bidVolumes);
+    ProfileScope profile(profiler, ProfiledHandler::TradeTicks);
+    HandlerScope scope(*this);
+    hot.eventTime = journal.recordBook(JournalEvent::TradeTicks, instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    refreshParams();
+
+    /* Log the trade ticks, and use them to evaluate mid calculations, on the analytics thread */
+    analytics.tradeTicks(time.getTime(), instrument, askPrices, askVolumes, bidPrices, bidVolumes);
+    if (instrument == Instrument::ETF) orderLifecycle.onTradeTicks(askPrices, askVolumes, bidPrices, bidVolumes);
+    tradeBars.onTradeTicks(instrument, hot.currSequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    bookDiff.onTradeTicks(instrument, askPrices, askVolumes, bidPrices, bidVolumes);
+}
+bool AutoTrader::isStaleBid(const StrategyParams &params, const Order &order, long mid, long bidPrice) {
+    /* a bid is stale if it is too uncompetitive, or too competitive. One we're already cancelling can't be stale again */
+    if (order.cancelling) return false;
+    long price = (long) order.price;
+    return (price - bidPrice > params.allowedUncompetitiveSlippage) || (mid - price < params.staleMinSpread);
+}
+bool AutoTrader::isStaleAsk(const StrategyParams &params, const Order &order, long mid, long askPrice) {
+    /* an ask is stale if it is too uncompetitive, or too competitive. One we're already cancelling can't be stale again */
+    if (order.cancelling) return false;
+    long price = (long) order.price;
+    return (askPrice - price > params.allowedUncompetitiveSlippage) || (price - mid < params.staleMinSpread);
 }
 std::pair<long, long> AutoTrader::detectStaleOrders(long mid, long bidPrice, long askPrice) {
     /* Cancel stale orders */
     long bidsCancelled = 0, asksCancelled = 0;
 
-    static const long allowedUncompetitiveSlippage = 100;
-    static const long minSpread = 50; // half sided
-
     // check we have a valid price //todo: refine this and check elsewhere
     if (bidPrice != 0) {
-        for (auto order_pairs: allEtfBooks.getBids()) {
+        for (auto order_pairs: primaryBook->bids) {
             Order order = order_pairs.second;
-
-            // cancel if too uncompetitive, or too competitive
-            if ((order.price - bidPrice > allowedUncompetitiveSlippage) ||
-                (mid - order.price < minSpread)) {
+            if (isStaleBid(*params, order, mid, bidPrice)) {
                 if (cancelOrder(order.clientOrderID))
                     bidsCancelled++;
             }
@@ -216,12 +531,9 @@ std::pair<long, long> AutoTrader::detectStaleOrders(long mid, long bidPrice, lon
     }
 
     if (askPrice != 0) {
-        for (auto order_pairs: allEtfBooks.getAsks()) {
+        for (auto order_pairs: primaryBook->asks) {
             Order order = order_pairs.second;
-
-            // cancel if too uncompetitive, or too competitive
-            if ((askPrice - order.price > allowedUncompetitiveSlippage) ||
-                (order.price - mid < minSpread)) {
+            if (isStaleAsk(*params, order, mid, askPrice)) {
                 if (cancelOrder(order.clientOrderID))
                     asksCancelled++;
             }
@@ -232,14 +544,12 @@ std::pair<long, long> AutoTrader::detectStaleOrders(long mid, long bidPrice, lon
 }
 void AutoTrader::hedge() {
     // hedge all our exposure
-    long totalExposure = allEtfBooks.getExposure() + allFutureBooks.getExposure();
+    long totalExposure = hot.etfPosition + hot.futurePosition;
     Side side = totalExposure > 0 ? Side::SELL : Side::BUY;
 
     // at a spread of hedgeSpread from our last quoted price
-    static const long hedgeSpread = 100;
-    std::optional<double> lastBid = bidPriceHistory.getBack(), lastAsk = askPriceHistory.getBack();
-    if (!(lastBid.has_value() && lastAsk.has_value())) return;
-    long hedgePrice = side == Side::BUY ? lastBid.value() + hedgeSpread : lastAsk.value() - hedgeSpread;
+    if (hot.lastQuotedMid == 0) return;
+    long hedgePrice = side == Side::BUY ? hot.lastBidQuote + params->hedgeSpread : hot.lastAskQuote - params->hedgeSpread;
 
     // send the order
     if (time.getTime() > 1)
@@ -257,33 +567,16 @@ std::pair<long, long> AutoTrader::getOrderPrices(long mid,
     /* Specifically, our price is the closest to being at a certain orderbook priority,
      * such that we lie between a (min_spread, max_spread). */
 
-    static const long minSpread = 150, maxSpread = 500; // note this is one-sided, so total spread would be 2*minSpread
-
-    Interval bidRange = Interval(mid - maxSpread, mid - minSpread);
-    Interval askRange = Interval(mid + minSpread, mid + maxSpread);
-
     // we either want to be at priority defaultMaxPriority, or if we are super exposed, trade at the front of the book
     static const long defaultMaxPriority = 0;
-    const static long maxAskPriority = 100;
-    const static long maxBidPriority = 100;
-
-    // find the prices such that we get a certain orderbook priority
-    long priorityBid = 0, priorityAsk = 0;
-    long __totalBids = 0, __totalAsks = 0;
-    for (int i = 0; i < TOP_LEVEL_COUNT; i++) {
-        __totalBids += bidVolumes[i];
-        if ((__totalBids >= maxBidPriority) && (priorityBid == 0)) {
-            priorityBid = bidPrices[std::max(0, i - 1)];
-        }
 
-        __totalAsks += askVolumes[i];
-        if ((__totalAsks >= maxAskPriority) && (priorityAsk == 0)) {
-            priorityAsk = askPrices[std::max(0, i - 1)];
-        }
-    }
-
-    long bidPrice = priorityBid != 0 ? bidRange.getClosestToValue(priorityBid) : bidRange.lower;
-    long askPrice = priorityAsk != 0 ? askRange.getClosestToValue(priorityAsk) : askRange.upper;
+    // find the prices such that we get a certain orderbook priority. These only depend on the mid and the book, so
+    // are cached between ticks
+    std::pair<long, long> priorityPrices = priorityPricesCache.getOrCompute(
+            std::make_tuple(mid, BookKey(askPrices, askVolumes, bidPrices, bidVolumes)),
+            [&] () { return getPriorityQuotes(mid, *params, askPrices, askVolumes, bidPrices, bidVolumes); });
+    long bidPrice = priorityPrices.first;
+    long askPrice = priorityPrices.second;
     /* ###########################    END    ########################### */
 
     /* ########################### SECTION 2 ########################### */
@@ -291,23 +584,30 @@ std::pair<long, long> AutoTrader::getOrderPrices(long mid,
 
     /* Check for momentum signal */
     std::optional<Signal> signalOptional = repeatedTradeMomentum.getSignal();
-    const static long momentumSlippage = 300;
     if (signalOptional.has_value()) {
         if (signalOptional.value() == up_trend) {
-            bidPrice += 100;
-            askPrice += momentumSlippage;
+            bidPrice += params->momentumLean;
+            askPrice += params->momentumSlippage;
         } else if (signalOptional.value() == down_trend) {
-            bidPrice -= momentumSlippage;
-            askPrice -= 100;
+            bidPrice -= params->momentumSlippage;
+            askPrice -= params->momentumLean;
         }
     }
+
+    /* Lean both quotes towards a lopsided book */
+    std::optional<Signal> imbalanceOptional = volumeImbalance.getSignal();
+    if (imbalanceOptional.has_value()) {
+        long lean = imbalanceOptional.value() == up_trend ? params->imbalanceLean : -params->imbalanceLean;
+        bidPrice += lean;
+        askPrice += lean;
+    }
     /* ###########################    END    ########################### */
 
 
     // finally log this price
-    spreadHistory.push(askPrice - bidPrice);
-    bidPriceHistory.push(bidPrice);
-    askPriceHistory.push(askPrice);
+    history->spreadHistory.push(askPrice - bidPrice);
+    history->bidPriceHistory.push(bidPrice);
+    history->askPriceHistory.push(askPrice);
 
     return {bidPrice, askPrice};
 }
@@ -317,24 +617,148 @@ void AutoTrader::makeMarket(long mid,
                             const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
                             const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
 {
+    ProfileScope profile(profiler, ProfiledHandler::MakeMarket);
     /* Get the prices which we quote at */
     std::pair<long, long> prices = getOrderPrices(mid, askPrices, askVolumes, bidPrices, bidVolumes);
-    long bidPrice = prices.first;
-    long askPrice = prices.second;
 
-    /* Cancel orders that are stale */
+    /* If neither our quotes nor our orders have changed since we last requoted, there is nothing to send */
+    if (requoteCache.get({mid, prices.first, prices.second, hot.ordersVersion}) != nullptr) return;
+
+    unsigned long refusals = frequencyLimiter.getRefusals(), riskRefusals = riskGate.getRefusals();
+    requote(mid, prices.first, prices.second);
+
+    // only skip next time if every message got through, at the size we asked for, as what held it back may have cleared
+    if ((frequencyLimiter.getRefusals() == refusals) && (riskGate.getRefusals() == riskRefusals))
+        requoteCache.set({mid, prices.first, prices.second, hot.ordersVersion}, true);
+    else
+        requoteCache.invalidate();
+}
+void AutoTrader::onFutureMidMove(long futureMid) {
+    /* Called on every futures book. The ETF book for this sequence lands a message later, so if the futures
+     * mid has moved far enough we shift our last quotes by the move, and sweep/ requote against them now. */
+    if (hot.lastQuotedMid == 0) return; // we haven't quoted yet
+    long midMove = futureMid - hot.lastQuotedMid;
+    if (std::abs(midMove) < params->requoteThreshold) return;
+
+    /* Usually we precomputed our reaction to this move, so just send it */
+    const QuoteReaction *reaction = reactionTable.lookup(futureMid);
+    if (reaction != nullptr) {
+        sendReaction(futureMid, *reaction);
+        return;
+    }
+
+    requote(futureMid, hot.lastBidQuote + midMove, hot.lastAskQuote + midMove);
+}
+void AutoTrader::requote(long mid, long bidPrice, long askPrice) {
+    /* Cancels any orders that are stale against the given quotes, then tops up our orders at those quotes */
+    hot.lastQuotedMid = mid;
+    hot.lastBidQuote = bidPrice;
+    hot.lastAskQuote = askPrice;
+
+    /* Cancel orders that are stale, and replace them */
     std::pair<long, long> canceledOrders = detectStaleOrders(mid, bidPrice, askPrice);
+    topUpQuotes(bidPrice, askPrice, canceledOrders.first, canceledOrders.second);
 
-    /* Try to trade very little, and very often. */
-    static const long lotSize = 50;
-    static const long maxSubmittedOrders = 50;
+    /* Now the messages are out, get ready for the next futures move */
+    buildReactionTable(mid, bidPrice, askPrice);
+}
+void AutoTrader::sendReaction(long mid, const QuoteReaction &reaction) {
+    /* Sends a precomputed reaction to a futures move */
+    hot.lastQuotedMid = mid;
+    hot.lastBidQuote = reaction.bidPrice;
+    hot.lastAskQuote = reaction.askPrice;
 
+    long bidsCancelled = 0, asksCancelled = 0;
+    for (unsigned long clientOrderID: reaction.bidCancels)
+        if (cancelOrder(clientOrderID)) bidsCancelled++;
+    for (unsigned long clientOrderID: reaction.askCancels)
+        if (cancelOrder(clientOrderID)) asksCancelled++;
+    topUpQuotes(reaction.bidPrice, reaction.askPrice, bidsCancelled, asksCancelled);
+
+    buildReactionTable(mid, reaction.bidPrice, reaction.askPrice);
+}
+void AutoTrader::topUpQuotes(long bidPrice, long askPrice, long bidsCancelled, long asksCancelled) {
+    /* Try to trade very little, and very often. */
     /* Add canceled orders onto order limit */
-    long bidSize = std::min(lotSize, maxSubmittedOrders + canceledOrders.first - allEtfBooks.getSubmittedBids());
-    long askSize = std::min(lotSize, maxSubmittedOrders + canceledOrders.second - allEtfBooks.getSubmitedAsks());
+    long bidSize = std::min(params->lotSize, params->maxSubmittedOrders + bidsCancelled - hot.quotedBids);
+    long askSize = std::min(params->lotSize, params->maxSubmittedOrders + asksCancelled - hot.quotedAsks);
 
     /* Send orders */
     sendOrder("ETF", Instrument::ETF, Side::BUY, bidSize, bidPrice);
     sendOrder("ETF", Instrument::ETF, Side::SELL, askSize, askPrice);
 }
+void AutoTrader::buildReactionTable(long mid, long bidPrice, long askPrice) {
+    /* Precompute the cancels and quotes for each of the likely next futures moves, assuming we shift our
+     * quotes by the move as in onFutureMidMove */
+    reactionTable.reset(mid);
+    const OrderList &bids = primaryBook->bids, &asks = primaryBook->asks;
+
+    for (long step = -ReactionTable::maxSteps; step <= ReactionTable::maxSteps; step++) {
+        long move = step * ReactionTable::stepSize;
+        QuoteReaction &reaction = reactionTable.at(step);
+        reaction.bidPrice = bidPrice + move;
+        reaction.askPrice = askPrice + move;
+
+        for (auto &pair: bids)
+            if (isStaleBid(*params, pair.second, mid + move, reaction.bidPrice)) reaction.bidCancels.push_back(pair.first);
+        for (auto &pair: asks)
+            if (isStaleAsk(*params, pair.second, mid + move, reaction.askPrice)) reaction.askCancels.push_back(pair.first);
+    }
+}
+void AutoTrader::hostStrategy(const std::string &name, std::unique_ptr<QuotingStrategy> strategy, double positionShare) {
+    /* Runs a strategy alongside ours, in a book of its own */
+    allEtfBooks.addBook(name);
+    hostedStrategies.push_back(std::make_unique<HostedStrategy>(name, std::move(strategy), positionShare,
+                                                                reloadParams && !SessionJournal::replaying()));
+}
+void AutoTrader::runHostedStrategies(const MarketSnapshot &snapshot) {
+    /* Quotes for each hosted strategy, after our own strategy has quoted. Our strategy keeps first call on the
+     * message budget; the hosted strategies split whatever is spare beyond a reserve for our cancels and hedges */
+    static const long reservedMessages = 20;
+
+    long spareMessages = frequencyLimiter.getHeadroom() - reservedMessages;
+    if (spareMessages <= 0) return;
+    long messageBudget = spareMessages / (long) hostedStrategies.size();
+
+    for (std::unique_ptr<HostedStrategy> &hosted: hostedStrategies) {
+        const StrategyParams *latest = hosted->params.enter();
+        if (latest != hosted->adopted) {
+            hosted->adopted = latest;
+            journal.recordParams(hosted->params.getPath(), *latest);
+        }
+        const StrategyParams &strategyParams = *latest;
+        const Book &book = *allEtfBooks.findBook(hosted->name);
+        std::pair<long, long> quotes = hosted->strategy->getQuotes(snapshot, strategyParams);
+        long messagesSent = 0;
+
+        /* Cancel this strategy's stale orders */
+        long bidsCancelled = 0, asksCancelled = 0;
+        for (auto &pair: book.bids) {
+            if ((messagesSent < messageBudget) && (quotes.first != 0) &&
+                isStaleBid(strategyParams, pair.second, snapshot.quoteMid, quotes.first)) {
+                messagesSent++;
+                if (cancelOrder(pair.first)) bidsCancelled++;
+            }
+        }
+        for (auto &pair: book.asks) {
+            if ((messagesSent < messageBudget) && (quotes.second != 0) &&
+                isStaleAsk(strategyParams, pair.second, snapshot.quoteMid, quotes.second)) {
+                messagesSent++;
+                if (cancelOrder(pair.first)) asksCancelled++;
+            }
+        }
 
+        /* Top up, within this strategy's share of the position limit. sendOrder still holds us to the shared limit */
+        long positionLimit = (long) (hosted->positionShare * TradingParameters::positionLimit);
+        long bidSize = std::min({strategyParams.lotSize,
+                                 strategyParams.maxSubmittedOrders + bidsCancelled - book.submittedBids,
+                                 positionLimit - book.exposure - book.submittedBids + bidsCancelled});
+        long askSize = std::min({strategyParams.lotSize,
+                                 strategyParams.maxSubmittedOrders + asksCancelled - book.submittedAsks,
+                                 positionLimit + book.exposure - book.submittedAsks + asksCancelled});
+        if ((quotes.first != 0) && (bidSize > 0) && (messagesSent++ < messageBudget))
+            sendOrder(hosted->name, Instrument::ETF, Side::BUY, bidSize, quotes.first);
+        if ((quotes.second != 0) && (askSize > 0) && (messagesSent++ < messageBudget))
+            sendOrder(hosted->name, Instrument::ETF, Side::SELL, askSize, quotes.second);
+    }
+}
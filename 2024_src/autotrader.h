@@ -22,41 +22,67 @@
 #include "data_handling.h"
 #include "rate_limiter.h"
 #include "signals.h"
+#include "reaction_table.h"
+#include "incremental.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "checkpoint.h"
+#include "analytics.h"
+#include "run_mode.h"
+#include "strategy_params.h"
+#include "strategy_host.h"
+#include "order_lifecycle.h"
+#include "perf_counters.h"
+#include "bars.h"
+#include "book_diff.h"
+#include "risk_gate.h"
+#include "outbound_batch.h"
 
 using namespace ReadyTraderGo;
 
-struct Interval {
-    /* This class stores an interval of values, and has some basic operations */
+struct alignas(64) HotState {
+    /* The values the tick path reads and writes, packed into two cache lines */
+    long currSequenceNumber = 0;
+    std::int64_t eventTime = 0; // timestamp of the callback we're handling, from the journal
+    long lastFutureMid = 0; // mid of the last futures book
+    long lastQuotedMid = 0; // the futures mid we last quoted around, 0 if we haven't quoted yet
+    long lastBidQuote = 0, lastAskQuote = 0; // the prices we last quoted at
 
-    double lower, upper; // lower and upper inclusive bounds
+    /* Our position, copied out of the books whenever an order is sent, filled or closed, see syncPosition */
+    long etfPosition = 0, futurePosition = 0;
+    long quotedBids = 0, quotedAsks = 0; // open volume in the main strategy's book, see topUpQuotes
+    unsigned long ordersVersion = 0; // the ETF books' version
+};
 
-    // constructors
-    Interval() {
-        lower = -1e9;
-        upper = 1e9;
+struct RequoteKey {
+    /* the inputs to our last requote */
+    long mid, bidPrice, askPrice;
+    unsigned long ordersVersion;
+    bool operator==(const RequoteKey &other) const {
+        return (mid == other.mid) && (bidPrice == other.bidPrice) && (askPrice == other.askPrice) &&
+               (ordersVersion == other.ordersVersion);
     }
-    Interval(double l, double u): lower(l), upper(u) {}
+};
 
-    void print() {
-        std::cout << "[" << lower << ", " << upper << "]\n";
-    }
+struct TraderHistory {
+    /* Bulk history, only used for diagnostics and metrics, so kept behind a pointer and off the tick path */
+    MemoryBudget budget;
+    MarketStream etfPriceHistory, futuresPriceHistory; // store fair values
+    MarketStream networthHistory; // store our networth
+    MarketStream spreadHistory; // store our spread
+    MarketStream bidPriceHistory, askPriceHistory; // store our quoted prices
+    std::queue<ExchangeOrderBookData> etfExchangeOrderBookData, futureExchangeOrderBookData; // store exchange data
 
-    // updates the bounds of the interval.
-    // if lower > upper, we shift the interval so lower=upper
-    void setLowerBound(double bound) {
-        lower = std::max(bound, lower);
-        upper = std::max(upper, lower);
-    }
-    void setUpperBound(double bound) {
-        upper = std::min(upper, bound);
-        lower = std::min(upper, lower);
-    }
+    TraderHistory(MemoryBudget budgetIn): budget(budgetIn),
+        etfPriceHistory(budget.streamCapacity), futuresPriceHistory(budget.streamCapacity),
+        networthHistory(budget.streamCapacity), spreadHistory(budget.streamCapacity),
+        bidPriceHistory(budget.streamCapacity), askPriceHistory(budget.streamCapacity) {}
 
-    double getClosestToValue(double val) {
-        // returns the closest number in the interval to the given value
-        if (val < lower) return lower;
-        if (val > upper) return upper;
-        return val;
+    void pushBook(Instrument instrument, const ExchangeOrderBookData &book) {
+        /* stores an exchange book, dropping the oldest if we're over budget */
+        std::queue<ExchangeOrderBookData> &books = instrument == Instrument::ETF ? etfExchangeOrderBookData : futureExchangeOrderBookData;
+        books.push(book);
+        if ((budget.bookCapacity != 0) && (books.size() > budget.bookCapacity)) books.pop();
     }
 };
 
@@ -87,53 +113,138 @@ public:
                                   const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
                                   const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) override;
 
+    /* Used by the journal player and load test */
+    SessionJournal &getJournal() { return journal; }
+    const AnalyticsPipeline &getAnalytics() const { return analytics; }
+    const BarAggregator &getTradeBars() const { return tradeBars; }
+    const BookDiffer &getBookDiff() const { return bookDiff; }
+    const RiskGate &getRiskGate() const { return riskGate; }
+    void replayParams(const JournalRecord &record);
+
+    /* Used by the low latency run mode, see run_mode.h */
+    void pinHelperThreads(int core);
+    void warmUp();
+
+    /* Hardware counters per handler, printed on disconnect */
+    const HandlerProfiler &getProfiler() const { return profiler; }
+
+    /* Save/ restore the trader's state */
+    bool saveCheckpoint(const std::string &path);
+    bool loadCheckpoint(const std::string &path);
+
 private:
-    /* Logger */
-    bool showMetrics = true;
-    bool useLogs = true; // TODO: CRUCIAL: disable if submitting to competition
-    Logger logger = Logger(useLogs);
-
-    /* Store market data */
-    MarketStream etfPriceHistory = MarketStream(); // store fair values
-    MarketStream futuresPriceHistory = MarketStream();
-    MarketStream networthHistory = MarketStream(); // store our networth
-    MarketStream spreadHistory = MarketStream(); // store our spread
-    MarketStream bidPriceHistory = MarketStream(), askPriceHistory = MarketStream(); // store our quoted prices
-    std::queue<ExchangeOrderBookData> etfExchangeOrderBookData, futureExchangeOrderBookData; // store exchange data
+    /* State touched on every tick, kept together at the front of the trader */
+    HotState hot;
+
+    /* Tuning parameters, reloaded from the file while we trade. params is refreshed at the start of every callback */
+    bool reloadParams = true;
+    const std::string paramsFile = "strategy_params.cfg";
+    StrategyParamStore paramStore = StrategyParamStore(paramsFile, reloadParams && !SessionJournal::replaying());
+    const StrategyParams *params = paramStore.enter();
+
+    /* Limit message frequency, and check our risk before sending */
+    MessageFrequencyLimiter frequencyLimiter;
+    RiskGate riskGate; // position, volume and price checks on every order, see sendOrder
+    OutboundBatch outbound; // what we've decided to send while handling the current message
+
+    /* Signals read on every tick, next to the rest of the tick state */
+    VolumeImbalance volumeImbalance; // updated on every book, of either instrument
+
+    /* Journal every message in and out, so a session can be replayed. A warm start keeps the journal it picks up from */
+    bool useJournal = true;
+    bool warmStart = false; // load the latest checkpoint on startup
+    SessionJournal journal = SessionJournal(useJournal, warmStart);
 
     /* Time and ID tracking */
-    long currSequenceNumber = 0;
     Time time = Time::getInstance();
     OrderIDGenerator idGen = OrderIDGenerator::getInstance();
 
+    /* Logger */
+    bool showMetrics = true;
+    bool useLogs = true; // TODO: CRUCIAL: disable if submitting to competition
+    // only written to by the analytics thread. A replay mustn't overwrite the logs of the session it's replaying
+    std::unique_ptr<Logger> logger = std::make_unique<Logger>(useLogs && !SessionJournal::replaying());
+
+    /* Logging and fair value scoring run on their own thread, fed by events from this one */
+    AnalyticsPipeline analytics = AnalyticsPipeline(logger.get());
+
+    /* Live telemetry, published to shared memory after every message we handle */
+    bool useTelemetry = true;
+    TelemetryPublisher telemetry = TelemetryPublisher(useTelemetry && !SessionJournal::replaying());
+    LatencyHistogram bookLatency; // time spent handling each ETF book
+
+    /* Hardware performance counters around the handlers. Costs two syscalls per handler, so off by default */
+    bool useProfiling = false;
+    HandlerProfiler profiler = HandlerProfiler(useProfiling);
+
+    /* Timestamps and queue position for every order, from send to close */
+    OrderLifecycleTracker orderLifecycle;
+
+    /* Store market data. Use MemoryBudget::bounded() for sessions much longer than a match */
+    MemoryBudget memoryBudget = MemoryBudget::unbounded();
+    std::unique_ptr<TraderHistory> history = std::make_unique<TraderHistory>(memoryBudget);
+
     /* Order book tracking */
-    TradeMatcher matchingEngine = TradeMatcher(&time, &logger);
+    TradeMatcher matchingEngine = TradeMatcher(&time, logger.get(), memoryBudget);
     std::vector<std::string> etfBookNames = std::vector<std::string>{"ETF"};
     std::vector<std::string> futureBookNames = std::vector<std::string>{"Future"};
-    BooksContainer allEtfBooks = BooksContainer(etfBookNames, Instrument::ETF, &logger, &time, &idGen, &matchingEngine);
-    BooksContainer allFutureBooks = BooksContainer(futureBookNames, Instrument::FUTURE, &logger, &time, &idGen, &matchingEngine);
+    BooksContainer allEtfBooks = BooksContainer(etfBookNames, Instrument::ETF, logger.get(), &time, &idGen, &matchingEngine);
+    BooksContainer allFutureBooks = BooksContainer(futureBookNames, Instrument::FUTURE, logger.get(), &time, &idGen, &matchingEngine);
 
-    /* Limit message frequency */
-    MessageFrequencyLimiter frequencyLimiter;
+    /* The main strategy trades through the "ETF" book. Other strategies can be hosted alongside it, each in its own book */
+    const Book *primaryBook = allEtfBooks.findBook(etfBookNames[0]);
+    bool hostAlternatives = false; // run the alternative strategies registered in the constructor
+    std::vector<std::unique_ptr<HostedStrategy>> hostedStrategies;
+
+    /* Our precomputed reaction to the next futures move */
+    ReactionTable reactionTable;
+
+    /* Trade ticks rolled up into bars, for signals to query */
+    BarAggregator tradeBars;
+
+    /* What changed between consecutive books, with traded volume told apart from cancellations */
+    BookDiffer bookDiff;
 
     /* Track our performance */
-    TraderMetrics metrics = TraderMetrics::getInstance(&allEtfBooks, &allFutureBooks, &networthHistory, &etfPriceHistory, &time);
+    TraderMetrics metrics = TraderMetrics(&allEtfBooks, &allFutureBooks, &history->networthHistory, &history->etfPriceHistory, &time);
 
     /* Mid estimates ~ initialised in the autotrader constructor */
     InverseVWAP inverseVwapEstimator = InverseVWAP();
-
-    /* Class to evaluate the estimators */
-    MidMetrics midMetrics = MidMetrics();
+    LeadLagEstimator leadLag; // how the ETF follows the futures, updated on every ETF book
 
     /* Signals */
-    RepeatedTradeMomentum repeatedTradeMomentum = RepeatedTradeMomentum(&matchingEngine, &logger, &time);
+    RepeatedTradeMomentum repeatedTradeMomentum = RepeatedTradeMomentum(&matchingEngine, logger.get(), &time);
+
+    /* Cached pipeline stages, so quiet ticks skip work */
+    StageCache<std::tuple<long, BookKey>, std::pair<long, long>> priorityPricesCache; // (mid, ETF book) -> priority prices
+    StageCache<RequoteKey, bool> requoteCache; // the inputs of our last requote
+
+    /* Checkpoint our state every so often, so a replay can start part way through, or a restart can warm start.
+     * Replays only ever read checkpoints */
+    bool useCheckpoints = true;
+    double lastCheckpointTime = 0;
+    const std::string checkpointPrefix = "custom_log/checkpoint_";
+    void checkpoint();
+    void serialiseCheckpoint(CheckpointWriter &writer);
+    void resumeFromCheckpoint();
+    void dropRestoredOrders();
 
     /* Trading logic */
+    void refreshParams();
     void makeMarket(long mid,
                     const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
                     const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
                     const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
                     const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes);
+    void onFutureMidMove(long futureMid);
+    void requote(long mid, long bidPrice, long askPrice);
+    void sendReaction(long mid, const QuoteReaction &reaction);
+    void topUpQuotes(long bidPrice, long askPrice, long bidsCancelled, long asksCancelled);
+    void buildReactionTable(long mid, long bidPrice, long askPrice);
+    void hostStrategy(const std::string &name, std::unique_ptr<QuotingStrategy> strategy, double positionShare);
+    void runHostedStrategies(const MarketSnapshot &snapshot);
+    static bool isStaleBid(const StrategyParams &params, const Order &order, long mid, long bidPrice);
+    static bool isStaleAsk(const StrategyParams &params, const Order &order, long mid, long askPrice);
     std::pair<long, long> detectStaleOrders(long mid, long bidPrice, long askPrice);
     std::pair<long, long> getOrderPrices(long mid,
                                              const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
@@ -146,9 +257,32 @@ private:
     bool sendOrder(std::string name, Instrument instrument, ReadyTraderGo::Side side, long size, long price);
     bool cancelOrder(unsigned long clientOrderID);
 
+    /* All messages to the exchange go through these. They're staged, and journaled and sent by flushOutbound */
+    void exchangeInsertOrder(unsigned long clientOrderID, Side side, unsigned long price, unsigned long size);
+    void exchangeHedgeOrder(unsigned long clientOrderID, Side side, unsigned long price, unsigned long size);
+    void exchangeCancelOrder(unsigned long clientOrderID);
+    void flushOutbound();
+    class HandlerScope {
+        /* When a handler returns, however it returns, sends what it staged and publishes telemetry */
+    public:
+        HandlerScope(AutoTrader &traderIn): trader(traderIn) {}
+        ~HandlerScope() {
+            trader.flushOutbound();
+            trader.publishTelemetry();
+        }
+        HandlerScope(const HandlerScope&) = delete;
+        HandlerScope &operator=(const HandlerScope&) = delete;
+    private:
+        AutoTrader &trader;
+    };
+
     /* Called when an order is filled or closed */
     void orderFilled(unsigned long clientOrderID, long price, long fillVolume);
     void orderClosed(unsigned long clientOrderID);
+    void syncPosition();
+
+    /* Fills in and publishes a telemetry snapshot, at the end of every handler */
+    void publishTelemetry();
 
     /* Used to print out debugging information */
     void debugPrint();
@@ -0,0 +1,132 @@
+#ifndef READY_TRADER_GO_2024_BARS_H
+#define READY_TRADER_GO_2024_BARS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <ready_trader_go/types.h>
+#include "checkpoint.h"
+
+/* Trade ticks rolled up into bars, at several resolutions at once, so signals can ask e.g. "how much was bought in
+ * the last five seconds" without walking raw history.
+ *
+ * Bars are timed in book sequences, four to a second. Each tick updates the open bar at every resolution in O(1),
+ * and a bar is closed into a fixed ring when a tick arrives for a later one. Bars with no trades are never opened, so
+ * consecutive bars in a ring needn't be adjacent in time; check startSequence. */
+
+struct Bar {
+    unsigned long startSequence = 0;
+    unsigned long open = 0, high = 0, low = 0, close = 0;
+    unsigned long volume = 0, trades = 0;
+    unsigned long long notional = 0; // sum of price * volume, for the VWAP
+    long signedVolume = 0; // volume bought at the ask, less volume sold at the bid
+
+    double getVWAP() const {
+        return volume == 0 ? 0 : (double) notional / (double) volume;
+    }
+    void addTrade(unsigned long price, unsigned long tradeVolume, bool bought) {
+        if (trades == 0) open = high = low = price;
+        high = std::max(high, price);
+        low = std::min(low, price);
+        close = price;
+        volume += tradeVolume;
+        notional += (unsigned long long) price * tradeVolume;
+        signedVolume += bought ? (long) tradeVolume : -(long) tradeVolume;
+        trades ++;
+    }
+};
+
+class BarSeries {
+    /* The bars of one instrument at one resolution: the open bar, and a ring of the most recent closed ones */
+public:
+    static constexpr std::size_t capacity = 64;
+
+    BarSeries(unsigned long resolutionIn = 1): resolution(resolutionIn) {}
+
+    void addTrade(unsigned long sequenceNumber, unsigned long price, unsigned long volume, bool bought) {
+        unsigned long startSequence = sequenceNumber - sequenceNumber % resolution;
+        if ((current.trades > 0) && (startSequence != current.startSequence)) {
+            closed[closedCount % capacity] = current;
+            closedCount ++;
+            current = Bar();
+        }
+        current.startSequence = startSequence;
+        current.addTrade(price, volume, bought);
+    }
+
+    unsigned long getResolution() const {
+        return resolution;
+    }
+    const Bar &getCurrent() const {
+        /* the bar still being built. Empty if we've never seen a trade */
+        return current;
+    }
+    std::size_t getClosedCount() const {
+        /* closed bars we still hold */
+        return std::min(closedCount, capacity);
+    }
+    const Bar &getClosed(std::size_t back) const {
+        /* the back'th most recently closed bar, from 0. back must be below getClosedCount() */
+        return closed[(closedCount - 1 - back) % capacity];
+    }
+    long getSignedVolumeSince(unsigned long sequenceNumber) const {
+        /* signed volume over the bars starting at or after the given sequence, the open bar included */
+        long total = current.startSequence >= sequenceNumber ? current.signedVolume : 0;
+        for (std::size_t back = 0; back < getClosedCount(); back++) {
+            const Bar &bar = getClosed(back);
+            if (bar.startSequence < sequenceNumber) break;
+            total += bar.signedVolume;
+        }
+        return total;
+    }
+private:
+    unsigned long resolution; // in sequences
+    Bar current;
+    std::array<Bar, capacity> closed;
+    std::size_t closedCount = 0; // ever closed
+};
+
+enum class BarResolution : int {
+    Sequence, OneSecond, FiveSeconds, ThirtySeconds, Count
+};
+
+class BarAggregator {
+public:
+    BarAggregator() {
+        static const std::array<unsigned long, (int) BarResolution::Count> resolutions = {1, 4, 20, 120};
+        for (auto &instrumentSeries: series)
+            for (int r = 0; r < (int) BarResolution::Count; r++) instrumentSeries[r] = BarSeries(resolutions[r]);
+    }
+
+    void onTradeTicks(ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+        /* Each traded level counts as a trade. We don't know the order within a message, so take buys then sells,
+         * each sweeping outwards from the touch */
+        auto &instrumentSeries = series[instrument == ReadyTraderGo::Instrument::ETF ? 1 : 0];
+        for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++) {
+            if (askVolumes[i] == 0) continue;
+            for (BarSeries &bars: instrumentSeries) bars.addTrade(sequenceNumber, askPrices[i], askVolumes[i], true);
+        }
+        for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++) {
+            if (bidVolumes[i] == 0) continue;
+            for (BarSeries &bars: instrumentSeries) bars.addTrade(sequenceNumber, bidPrices[i], bidVolumes[i], false);
+        }
+    }
+    const BarSeries &getBars(ReadyTraderGo::Instrument instrument, BarResolution resolution) const {
+        return series[instrument == ReadyTraderGo::Instrument::ETF ? 1 : 0][(int) resolution];
+    }
+
+    void save(CheckpointWriter &writer) const {
+        writer.write(series);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(series);
+    }
+private:
+    std::array<std::array<BarSeries, (int) BarResolution::Count>, 2> series; // futures, then ETF
+};
+
+#endif //READY_TRADER_GO_2024_BARS_H
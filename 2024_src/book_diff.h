@@ -0,0 +1,220 @@
+#ifndef READY_TRADER_GO_2024_BOOK_DIFF_H
+#define READY_TRADER_GO_2024_BOOK_DIFF_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <ready_trader_go/types.h>
+#include "checkpoint.h"
+
+/* The exchange sends the whole top of the book every sequence. BookDiffer turns each pair of consecutive snapshots
+ * into a short list of level events, so consumers can update from what changed rather than re-reading every level.
+ *
+ * Levels are matched by price, walking both ladders from the touch. Most books only change volume, so we first
+ * compare the price arrays whole, and if they match skip the walk and just take the volume differences. A price
+ * that scrolls in or out at the far end of the top five hasn't really been added or removed, so isn't reported.
+ *
+ * Trade ticks for a sequence arrive after its book, and describe trades the book already shows. When they do, the
+ * volume that left each traded level is re-labelled as traded, so what's left as VolumeDown or Removed is
+ * cancellations. */
+
+enum class LevelEventType : std::uint8_t {
+    Added, Removed, VolumeUp, VolumeDown, Traded, TouchMoved, Count
+};
+
+struct LevelEvent {
+    LevelEventType type;
+    ReadyTraderGo::Side side; // BUY for the bid ladder, SELL for the asks
+    unsigned long price;
+    long change; // the change in volume at the price, or for TouchMoved, the change in the best price
+};
+
+class BookEvents {
+    /* The events between one snapshot of an instrument and the next. Fixed size, so building it never allocates */
+public:
+    // per side: a walk emits at most one event per level of either snapshot, plus the touch, plus a trade per level
+    static constexpr std::size_t capacity = 2 * (3 * ReadyTraderGo::TOP_LEVEL_COUNT + 1);
+
+    void clear() {
+        count = 0;
+    }
+    void push(LevelEventType type, ReadyTraderGo::Side side, unsigned long price, long change) {
+        if (count < capacity) events[count++] = {type, side, price, change};
+    }
+    std::size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    LevelEvent &operator[](std::size_t i) {
+        return events[i];
+    }
+    const LevelEvent &operator[](std::size_t i) const {
+        return events[i];
+    }
+    const LevelEvent *begin() const {
+        return events.data();
+    }
+    const LevelEvent *end() const {
+        return events.data() + count;
+    }
+private:
+    std::array<LevelEvent, capacity> events;
+    std::size_t count = 0;
+};
+
+class BookDiffer {
+public:
+    void onOrderBook(ReadyTraderGo::Instrument instrument,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+        InstrumentBook &book = get(instrument);
+        book.events.clear();
+        if (book.seen) {
+            diffSide(book.asks, askPrices, askVolumes, ReadyTraderGo::Side::SELL, book.events);
+            diffSide(book.bids, bidPrices, bidVolumes, ReadyTraderGo::Side::BUY, book.events);
+        }
+        book.asks = {askPrices, askVolumes};
+        book.bids = {bidPrices, bidVolumes};
+        book.seen = true;
+        count(book.events);
+    }
+    void onTradeTicks(ReadyTraderGo::Instrument instrument,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+        /* Moves traded volume out of the decreases at each traded price. Trades at the asks took ask volume */
+        BookEvents &events = get(instrument).events;
+        uncount(events);
+        for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++) {
+            if (askVolumes[i] != 0) reconcileTrade(events, ReadyTraderGo::Side::SELL, askPrices[i], (long) askVolumes[i]);
+            if (bidVolumes[i] != 0) reconcileTrade(events, ReadyTraderGo::Side::BUY, bidPrices[i], (long) bidVolumes[i]);
+        }
+        count(events);
+    }
+
+    const BookEvents &getEvents(ReadyTraderGo::Instrument instrument) const {
+        /* the events between the last two books, reconciled with any trade ticks since */
+        return instrument == ReadyTraderGo::Instrument::ETF ? etf.events : future.events;
+    }
+
+    void save(CheckpointWriter &writer) const {
+        writer.write(etf);
+        writer.write(future);
+        writer.write(totals);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(etf);
+        reader.read(future);
+        reader.read(totals);
+    }
+    void print() const {
+        static const char *typeNames[] = {"added", "removed", "volume up", "volume down", "traded", "touch moved"};
+        std::cout << "------=+ Book events +=------" << std::endl;
+        for (int instrument = 0; instrument < 2; instrument++) {
+            std::cout << "    - " << (instrument == 0 ? "Future" : "ETF") << ":";
+            for (int type = 0; type < (int) LevelEventType::Count; type++)
+                std::cout << " " << typeNames[type] << " = " << totals[instrument][type];
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
+    }
+private:
+    struct Ladder {
+        std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> prices = {}, volumes = {};
+    };
+    struct InstrumentBook {
+        Ladder asks, bids;
+        bool seen = false;
+        BookEvents events;
+    };
+    InstrumentBook etf, future;
+    std::array<std::array<unsigned long, (int) LevelEventType::Count>, 2> totals = {}; // events by type, futures then ETF
+
+    InstrumentBook &get(ReadyTraderGo::Instrument instrument) {
+        return instrument == ReadyTraderGo::Instrument::ETF ? etf : future;
+    }
+    std::array<unsigned long, (int) LevelEventType::Count> &getTotals(const BookEvents &events) {
+        return totals[&events == &etf.events ? 1 : 0];
+    }
+    void count(const BookEvents &events) {
+        for (const LevelEvent &event: events) getTotals(events)[(int) event.type] ++;
+    }
+    void uncount(const BookEvents &events) {
+        for (const LevelEvent &event: events) getTotals(events)[(int) event.type] --;
+    }
+
+    static void diffSide(const Ladder &old,
+                         const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &prices,
+                         const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &volumes,
+                         ReadyTraderGo::Side side, BookEvents &events) {
+        const int levels = ReadyTraderGo::TOP_LEVEL_COUNT;
+
+        /* Usually only volumes change */
+        if (old.prices == prices) {
+            for (int i = 0; i < levels; i++) {
+                long change = (long) volumes[i] - (long) old.volumes[i];
+                if ((change != 0) && (prices[i] != 0))
+                    events.push(change > 0 ? LevelEventType::VolumeUp : LevelEventType::VolumeDown, side, prices[i], change);
+            }
+            return;
+        }
+
+        if ((old.prices[0] != 0) && (prices[0] != 0) && (old.prices[0] != prices[0]))
+            events.push(LevelEventType::TouchMoved, side, prices[0], (long) prices[0] - (long) old.prices[0]);
+
+        /* Walk both ladders from the touch, matching levels by price. Empty levels have price 0, and are at the end */
+        auto better = [side](unsigned long a, unsigned long b) { return side == ReadyTraderGo::Side::BUY ? a > b : a < b; };
+        int oldDepth = 0, newDepth = 0;
+        while ((oldDepth < levels) && (old.prices[oldDepth] != 0)) oldDepth ++;
+        while ((newDepth < levels) && (prices[newDepth] != 0)) newDepth ++;
+        // a full ladder only shows us down to its last price, anything beyond could be there unseen
+        bool oldFull = oldDepth == levels, newFull = newDepth == levels;
+
+        int i = 0, j = 0;
+        while ((i < oldDepth) || (j < newDepth)) {
+            if ((i < oldDepth) && (j < newDepth) && (old.prices[i] == prices[j])) {
+                long change = (long) volumes[j] - (long) old.volumes[i];
+                if (change != 0)
+                    events.push(change > 0 ? LevelEventType::VolumeUp : LevelEventType::VolumeDown, side, prices[j], change);
+                i ++;
+                j ++;
+            } else if ((j == newDepth) || ((i < oldDepth) && better(old.prices[i], prices[j]))) {
+                // an old price with no match. If it would still be in view, it's gone
+                if (!newFull || better(old.prices[i], prices[newDepth - 1]))
+                    events.push(LevelEventType::Removed, side, old.prices[i], -(long) old.volumes[i]);
+                i ++;
+            } else {
+                // a new price with no match. If it would have been in view before, it's new
+                if (!oldFull || better(prices[j], old.prices[oldDepth - 1]))
+                    events.push(LevelEventType::Added, side, prices[j], (long) volumes[j]);
+                j ++;
+            }
+        }
+    }
+    static void reconcileTrade(BookEvents &events, ReadyTraderGo::Side side, unsigned long price, long traded) {
+        for (std::size_t e = 0; (e < events.size()) && (traded > 0); e++) {
+            LevelEvent &event = events[e];
+            if ((event.side != side) || (event.price != price)) continue;
+            if ((event.type != LevelEventType::VolumeDown) && (event.type != LevelEventType::Removed)) continue;
+
+            long explained = std::min(traded, -event.change);
+            if (explained == -event.change) {
+                event.type = LevelEventType::Traded;
+            } else {
+                event.change += explained;
+                events.push(LevelEventType::Traded, side, price, -explained);
+            }
+            traded -= explained;
+        }
+        // the level refilled after the trade, or the trade swept through it, so the book doesn't show it
+        if (traded > 0) events.push(LevelEventType::Traded, side, price, -traded);
+    }
+};
+
+#endif //READY_TRADER_GO_2024_BOOK_DIFF_H
@@ -0,0 +1,153 @@
+#ifndef READY_TRADER_GO_2024_CHECKPOINT_H
+#define READY_TRADER_GO_2024_CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* Checkpoints are binary snapshots of the trader's state. They let a replay start part way through a session,
+ * and let a restarted trader pick up where it left off rather than rebuilding its history from scratch.
+ * Each stateful class has a save(CheckpointWriter&) and load(CheckpointReader&), which must read fields back
+ * in the order they were written. */
+
+static constexpr char checkpointMagic[8] = {'R', 'T', 'G', 'C', 'K', 'P', 'T', '\0'};
+static constexpr std::uint32_t checkpointVersion = 8;
+
+static inline bool writeCheckpointFile(const std::string &path, const std::vector<char> &buffer) {
+    /* writes to a temporary file and renames it, so a reader never sees a half written checkpoint */
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios_base::binary | std::ios_base::trunc);
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    if (!file) return false;
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+class CheckpointWriter {
+public:
+    CheckpointWriter() {
+        buffer.insert(buffer.end(), checkpointMagic, checkpointMagic + sizeof(checkpointMagic));
+        write(checkpointVersion);
+    }
+
+    template <typename T>
+    void write(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written directly");
+        const char *bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    void write(const std::string &value) {
+        write((std::uint64_t) value.size());
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+    template <typename T>
+    void write(const std::vector<T> &values) {
+        write((std::uint64_t) values.size());
+        for (const T &value: values) write(value);
+    }
+    template <typename T>
+    void write(const std::deque<T> &values) {
+        write((std::uint64_t) values.size());
+        for (const T &value: values) write(value);
+    }
+    template <typename K, typename V>
+    void write(const std::map<K, V> &values) {
+        write((std::uint64_t) values.size());
+        for (const auto &pair: values) {
+            write(pair.first);
+            write(pair.second);
+        }
+    }
+
+    bool writeToFile(const std::string &path) const {
+        return writeCheckpointFile(path, buffer);
+    }
+    std::vector<char> release() {
+        /* hands over the serialised checkpoint, e.g. to be written on another thread */
+        return std::move(buffer);
+    }
+private:
+    std::vector<char> buffer;
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader(const std::string &path) {
+        std::ifstream file(path, std::ios_base::binary);
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        if ((buffer.size() < sizeof(checkpointMagic)) || (std::memcmp(buffer.data(), checkpointMagic, sizeof(checkpointMagic)) != 0)) {
+            ok = false;
+            return;
+        }
+        position = sizeof(checkpointMagic);
+        if (read<std::uint32_t>() != checkpointVersion) ok = false;
+    }
+
+    bool isOk() const {
+        /* false if the file wasn't a checkpoint, or we read past its end */
+        return ok;
+    }
+
+    template <typename T>
+    T read() {
+        T value{}; // zero if we read past the end
+        read(value);
+        return value;
+    }
+    template <typename T>
+    void read(T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read directly");
+        if (!take(sizeof(T))) return;
+        std::memcpy(&value, buffer.data() + position - sizeof(T), sizeof(T));
+    }
+    void read(std::string &value) {
+        std::uint64_t size = read<std::uint64_t>();
+        if (!take(size)) return;
+        value.assign(buffer.data() + position - size, size);
+    }
+    template <typename T>
+    void read(std::vector<T> &values) {
+        std::uint64_t size = read<std::uint64_t>();
+        values.clear();
+        for (std::uint64_t i = 0; (i < size) && ok; i ++) values.emplace_back(read<T>());
+    }
+    template <typename T>
+    void read(std::deque<T> &values) {
+        std::uint64_t size = read<std::uint64_t>();
+        values.clear();
+        for (std::uint64_t i = 0; (i < size) && ok; i ++) values.emplace_back(read<T>());
+    }
+    template <typename K, typename V>
+    void read(std::map<K, V> &values) {
+        std::uint64_t size = read<std::uint64_t>();
+        values.clear();
+        for (std::uint64_t i = 0; (i < size) && ok; i ++) {
+            K key;
+            read(key);
+            read(values[key]);
+        }
+    }
+private:
+    std::vector<char> buffer;
+    std::size_t position = 0;
+    bool ok = true;
+
+    bool take(std::size_t size) {
+        if ((!ok) || (buffer.size() - position < size)) {
+            ok = false;
+            return false;
+        }
+        position += size;
+        return true;
+    }
+};
+
+#endif //READY_TRADER_GO_2024_CHECKPOINT_H
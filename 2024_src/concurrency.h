@@ -0,0 +1,80 @@
+#ifndef READY_TRADER_GO_2024_CONCURRENCY_H
+#define READY_TRADER_GO_2024_CONCURRENCY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/* Building blocks for handing data between the trading thread and helper threads without locks */
+
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    /* A bounded single producer, single consumer queue. Neither side ever blocks: a push onto a full queue fails,
+     * and the producer decides what to do about it */
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+public:
+    SpscQueue(): slots(Capacity) {}
+
+    bool tryPush(const T &item) {
+        /* producer only */
+        std::size_t currHead = head.load(std::memory_order_relaxed);
+        if (currHead - cachedTail == Capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (currHead - cachedTail == Capacity) return false;
+        }
+        slots[currHead & (Capacity - 1)] = item;
+        head.store(currHead + 1, std::memory_order_release);
+        return true;
+    }
+    bool tryPop(T &item) {
+        /* consumer only */
+        std::size_t currTail = tail.load(std::memory_order_relaxed);
+        if (currTail == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (currTail == cachedHead) return false;
+        }
+        item = slots[currTail & (Capacity - 1)];
+        tail.store(currTail + 1, std::memory_order_release);
+        return true;
+    }
+private:
+    std::vector<T> slots;
+
+    // the producer and consumer each get their own cache line, along with their cached copy of the other's index
+    alignas(64) std::atomic<std::size_t> head = 0;
+    std::size_t cachedTail = 0;
+    alignas(64) std::atomic<std::size_t> tail = 0;
+    std::size_t cachedHead = 0;
+};
+
+template <typename T>
+class Published {
+    /* A value written by one thread and read by others, under a seqlock. Writes never wait; a read retries if it
+     * overlaps a write */
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be published");
+public:
+    void publish(const T &value) {
+        std::size_t currSequence = sequence.load(std::memory_order_relaxed);
+        sequence.store(currSequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&this->value, &value, sizeof(T));
+        sequence.store(currSequence + 2, std::memory_order_release);
+    }
+    T read() const {
+        T copy;
+        while (true) {
+            std::size_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            std::memcpy(&copy, &value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) return copy;
+        }
+    }
+private:
+    std::atomic<std::size_t> sequence = 0;
+    T value = T();
+};
+
+#endif //READY_TRADER_GO_2024_CONCURRENCY_H
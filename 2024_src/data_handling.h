@@ -15,9 +15,10 @@ using namespace ReadyTraderGo;
 class MarketStream {
     /* A vector wrapper used to store and query a stream of market data */
 public:
-    MarketStream() {
-        data.reserve(1000 * 4); // as we get orderbook data four times a second, for 1000 seconds
-        logData.reserve(1000 * 4);
+    MarketStream(std::size_t capacityIn = 0): capacity(capacityIn) {
+        std::size_t reserved = capacity == 0 ? 1000 * 4 : 2 * capacity; // as we get orderbook data four times a second, for 1000 seconds
+        data.reserve(reserved);
+        logData.reserve(reserved);
     }
 
     void push(double value) {
@@ -33,6 +34,17 @@ public:
         }
 
         data.emplace_back(value);
+
+        /* keep running totals, so whole-history statistics survive trimming */
+        totalPushed ++;
+        totalSum += value;
+        totalSumSquares += value * value;
+
+        /* if we are bounded, drop the oldest half of the history once we hit twice our capacity */
+        if ((capacity != 0) && (data.size() >= 2 * capacity)) {
+            data.erase(data.begin(), data.end() - capacity);
+            logData.erase(logData.begin(), logData.end() - capacity);
+        }
     }
     std::optional<double> getBack() {
         /* returns last data item */
@@ -49,14 +61,23 @@ public:
         return &data;
     }
     long getSize() {
-        /* returns size of data stream */
-        return data.size();
+        /* returns size of data stream, including anything trimmed */
+        return totalPushed;
     }
 
     std::optional<double> getMean(int n) {
+        if ((n == -1) && isTrimmed()) {
+            if (totalPushed <= 1) return {};
+            return totalSum / totalPushed;
+        }
         return calculateMean(n, data);
     }
     std::optional<double> getStandardDeviation(int n) {
+        if ((n == -1) && isTrimmed()) {
+            if (totalPushed <= 1) return {};
+            double mean = totalSum / totalPushed;
+            return std::sqrt(std::max(0.0, (totalSumSquares - totalPushed * mean * mean) / (totalPushed - 1)));
+        }
         return calculateStandardDeviation(n, data);
     }
 
@@ -84,6 +105,20 @@ public:
 
         return beta;
     }
+    void save(CheckpointWriter &writer) const {
+        writer.write(data);
+        writer.write(logData);
+        writer.write(totalPushed);
+        writer.write(totalSum);
+        writer.write(totalSumSquares);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(data);
+        reader.read(logData);
+        reader.read(totalPushed);
+        reader.read(totalSum);
+        reader.read(totalSumSquares);
+    }
     std::optional<double> getRegressNext(int n) {
         /* uses linear regression to estimate the next value in the stream */
         return regressNext(n, data);
@@ -144,8 +179,16 @@ private:
         return alpha + beta * (double)n;
     }
 
+    bool isTrimmed() {
+        return totalPushed != (long) data.size();
+    }
+
     std::vector<double> data;
     std::vector<double> logData;
+
+    std::size_t capacity; // 0 if unbounded
+    long totalPushed = 0;
+    double totalSum = 0, totalSumSquares = 0;
 };
 
 class TraderMetrics {
@@ -155,14 +198,10 @@ private:
     MarketStream *networthHistory;
     MarketStream *mid;
     Time* time;
-
+public:
+    // one per trader, as it points into that trader's books and history
     TraderMetrics(BooksContainer *etfIn, BooksContainer *futuresIn, MarketStream *networthIn, MarketStream*midIn, Time *timeIn):
         etfBooks(etfIn), futuresBooks(futuresIn), networthHistory(networthIn), mid(midIn), time(timeIn) {}
-public:
-    static TraderMetrics& getInstance(BooksContainer *etfIn, BooksContainer *futuresIn, MarketStream *networthIn, MarketStream*midIn, Time *timeIn) {
-        static TraderMetrics instance(etfIn, futuresIn, networthIn, midIn, timeIn); // This instance is created only once
-        return instance;
-    }
     void outputMetrics() {
         /* Print the metrics to the command line */
         static int printingDelay = 50;
@@ -189,8 +228,8 @@ public:
                 std::cout << "------=+ Metrics at " << time->getTime() << " for " << pair.first << " +=------" << std::endl;
                 std::cout << "- Trading behaviour: " << std::endl
                     << "    - Lots filled per second = " << book.lotsFilled / time->getTime() << "/s = " << book.lotsFilled << " in total" << std::endl
-                    << "    - profit per lot = " << realisedProfit / book.lotsFilled / 100.0 << "£" << std::endl
-                    << "    - canceled orders / orders sent = " << 100 * book.ordersCancelled / (book.ordersSent) << "%" << std::endl << std::endl;
+                    << "    - profit per lot = " << (book.lotsFilled == 0 ? 0 : realisedProfit / book.lotsFilled / 100.0) << "£" << std::endl
+                    << "    - canceled orders / orders sent = " << (book.ordersSent == 0 ? 0 : 100 * book.ordersCancelled / book.ordersSent) << "%" << std::endl << std::endl;
 
             }
         }
@@ -198,7 +237,7 @@ public:
         std::cout << "------=+ Overall Trading Behaviour at " << time->getTime() << "+=------" << std::endl
                   << "    - Lots filled per second = " << totalLotsFilled / time->getTime() << "/s = " << totalLotsFilled << " in total" << std::endl
                   << "    - profit per lot = " << totalRealisedProfit / totalLotsFilled / 100.0 << "£" << std::endl
-                  << "    - canceled orders / orders sent = " << 100 * totalOrdersCancelled / (totalOrdersSent) << "%" << std::endl << std::endl;
+                  << "    - canceled orders / orders sent = " << (totalOrdersSent == 0 ? 0 : 100 * totalOrdersCancelled / totalOrdersSent) << "%" << std::endl << std::endl;
 
         std::cout << "------=+ Overall P&L +=------" << std::endl
                   << "    - Total return = " << networthHistory->getBack().value_or(0) / 100.0 << "£" << std::endl
@@ -0,0 +1,106 @@
+#ifndef READY_TRADER_GO_2024_EXCHANGE_PROTOCOL_H
+#define READY_TRADER_GO_2024_EXCHANGE_PROTOCOL_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/* The ReadyTraderGo wire format, for the loopback exchange.
+ *
+ * Every message starts with a three byte header: the message length (header included) as a big endian uint16, then
+ * the message type. Fields follow in network byte order, with no padding. */
+
+enum class WireMessageType : std::uint8_t {
+    AmendOrder = 1, CancelOrder = 2, Error = 3, HedgeFilled = 4, HedgeOrder = 5, InsertOrder = 6, Login = 7,
+    OrderFilled = 8, OrderStatus = 9, OrderBookUpdate = 10, TradeTicks = 11
+};
+
+static constexpr std::size_t wireHeaderSize = 3;
+static constexpr std::size_t wireBookLevels = 5;
+static constexpr std::size_t wireErrorLength = 50, wireLoginFieldLength = 20;
+
+static inline std::size_t getWireMessageSize(WireMessageType type) {
+    /* the full size of each message type, or 0 if we don't know it */
+    switch (type) {
+        case WireMessageType::AmendOrder: return wireHeaderSize + 8;
+        case WireMessageType::CancelOrder: return wireHeaderSize + 4;
+        case WireMessageType::Error: return wireHeaderSize + 4 + wireErrorLength;
+        case WireMessageType::HedgeFilled: return wireHeaderSize + 12;
+        case WireMessageType::HedgeOrder: return wireHeaderSize + 13;
+        case WireMessageType::InsertOrder: return wireHeaderSize + 14;
+        case WireMessageType::Login: return wireHeaderSize + 2 * wireLoginFieldLength;
+        case WireMessageType::OrderFilled: return wireHeaderSize + 12;
+        case WireMessageType::OrderStatus: return wireHeaderSize + 16;
+        case WireMessageType::OrderBookUpdate:
+        case WireMessageType::TradeTicks: return wireHeaderSize + 5 + 4 * wireBookLevels * 4;
+    }
+    return 0;
+}
+
+class WireWriter {
+    /* Builds one message in a fixed buffer */
+public:
+    WireWriter(WireMessageType type) {
+        data[2] = (std::uint8_t) type;
+        size = wireHeaderSize;
+    }
+    WireWriter &put8(std::uint8_t value) {
+        data[size++] = value;
+        return *this;
+    }
+    WireWriter &put32(std::uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) data[size++] = (std::uint8_t) (value >> shift);
+        return *this;
+    }
+    WireWriter &putString(const std::string &value, std::size_t length) {
+        /* a fixed length field, zero padded */
+        std::memset(&data[size], 0, length);
+        std::memcpy(&data[size], value.data(), std::min(length, value.size()));
+        size += length;
+        return *this;
+    }
+    const std::uint8_t *finish() {
+        data[0] = (std::uint8_t) (size >> 8);
+        data[1] = (std::uint8_t) size;
+        return data.data();
+    }
+    std::size_t getSize() const {
+        return size;
+    }
+private:
+    std::array<std::uint8_t, 128> data;
+    std::size_t size;
+};
+
+class WireReader {
+    /* Reads the fields of one message, after its header */
+public:
+    WireReader(const std::uint8_t *messageIn): message(messageIn), position(wireHeaderSize) {}
+
+    static std::size_t getLength(const std::uint8_t *header) {
+        return ((std::size_t) header[0] << 8) | header[1];
+    }
+    static WireMessageType getType(const std::uint8_t *header) {
+        return (WireMessageType) header[2];
+    }
+
+    std::uint8_t get8() {
+        return message[position++];
+    }
+    std::uint32_t get32() {
+        std::uint32_t value = 0;
+        for (int i = 0; i < 4; i++) value = (value << 8) | message[position++];
+        return value;
+    }
+    std::string getString(std::size_t length) {
+        const char *start = reinterpret_cast<const char*>(&message[position]);
+        position += length;
+        return std::string(start, strnlen(start, length));
+    }
+private:
+    const std::uint8_t *message;
+    std::size_t position;
+};
+
+#endif //READY_TRADER_GO_2024_EXCHANGE_PROTOCOL_H
@@ -0,0 +1,62 @@
+#ifndef READY_TRADER_GO_2024_INCREMENTAL_H
+#define READY_TRADER_GO_2024_INCREMENTAL_H
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <ready_trader_go/types.h>
+#include "checkpoint.h"
+
+/* In a quiet market most ticks look exactly like the last one. Each stage of the quoting pipeline caches its
+ * output against the inputs it was computed from, and only recomputes when one of those inputs changes. */
+
+// the four arrays of a book snapshot, compared as a whole
+typedef std::tuple<std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>,
+                   std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>,
+                   std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>,
+                   std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>> BookKey;
+
+template <typename Key, typename Value>
+class StageCache {
+    /* Caches the output of one stage, keyed on the inputs it was computed from */
+public:
+    const Value *get(const Key &key) const {
+        /* returns the cached output if the inputs are unchanged, else nullptr */
+        if (valid && (key == lastKey)) return &lastValue;
+        return nullptr;
+    }
+    const Value &set(const Key &key, Value value) {
+        lastKey = key;
+        lastValue = value;
+        valid = true;
+        return lastValue;
+    }
+    template <typename Compute>
+    const Value &getOrCompute(const Key &key, Compute compute) {
+        /* returns the cached output, or recomputes it if the inputs have changed */
+        const Value *cached = get(key);
+        if (cached != nullptr) return *cached;
+        return set(key, compute());
+    }
+    void invalidate() {
+        valid = false;
+    }
+    void save(CheckpointWriter &writer) const {
+        static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                      "only caches of plain values can be checkpointed");
+        writer.write(valid);
+        writer.write(lastKey);
+        writer.write(lastValue);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(valid);
+        reader.read(lastKey);
+        reader.read(lastValue);
+    }
+private:
+    Key lastKey;
+    Value lastValue;
+    bool valid = false;
+};
+
+#endif //READY_TRADER_GO_2024_INCREMENTAL_H
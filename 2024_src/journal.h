@@ -0,0 +1,352 @@
+#ifndef READY_TRADER_GO_2024_JOURNAL_H
+#define READY_TRADER_GO_2024_JOURNAL_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ready_trader_go/types.h>
+#include "checkpoint.h"
+#include "strategy_params.h"
+
+/* The session journal records every callback we receive from the exchange, and every message we send to it, in
+ * the order they happened. Unlike the CSV logs this is the raw input, so journal_player.cc can feed a session back
+ * into a fresh AutoTrader and check it sends exactly the same messages. Each block of parameters the trader adopts
+ * is recorded too, so a replay trades with the parameters the session had, not whatever the file holds now.
+ *
+ * Records are copied into a preallocated ring on the trading thread, and written to disk by a background thread.
+ * The same thread writes the checkpoints the trading thread serialises, so the trading thread never waits on the disk. */
+
+enum class JournalEvent : std::uint8_t {
+    // inbound
+    OrderBook, TradeTicks, OrderFilled, HedgeFilled, OrderStatus, Error, Disconnect,
+    // parameters the trader adopted while handling the callback before
+    Params,
+    // outbound
+    InsertOrder, HedgeOrder, CancelOrder
+};
+
+static constexpr std::int64_t journalTicksPerSecond = 1000000000; // journal timestamps are in nanoseconds
+
+struct JournalRecord {
+    /* A fixed size record, so the journal can be read back with a single read per record */
+    std::uint64_t index; // position in the journal
+    std::int64_t timestamp; // steady clock, in nanoseconds
+    JournalEvent event;
+    std::uint8_t instrument, side, lifespan;
+    std::uint64_t id; // the sequence number for market data, else the client order id
+    std::uint64_t price, volume, remainingVolume;
+    std::int64_t fees;
+    std::array<std::uint64_t, ReadyTraderGo::TOP_LEVEL_COUNT> askPrices, askVolumes, bidPrices, bidVolumes;
+    char message[64]; // error message truncated, or for Params, the path of the parameter file
+
+    bool isOutbound() const {
+        return event >= JournalEvent::InsertOrder;
+    }
+    std::uint64_t &paramSlot(std::size_t i) {
+        /* Params records keep the values in the ladder arrays, in strategyParamFields order */
+        std::array<std::uint64_t, ReadyTraderGo::TOP_LEVEL_COUNT> *ladders[] = {&askPrices, &askVolumes, &bidPrices, &bidVolumes};
+        return (*ladders[i / ReadyTraderGo::TOP_LEVEL_COUNT])[i % ReadyTraderGo::TOP_LEVEL_COUNT];
+    }
+    std::uint64_t paramSlot(std::size_t i) const {
+        return const_cast<JournalRecord*>(this)->paramSlot(i);
+    }
+};
+static_assert(std::size(strategyParamFields) <= 4 * ReadyTraderGo::TOP_LEVEL_COUNT,
+              "a Params record has no room for every parameter");
+
+struct JournalHeader {
+    char magic[8] = {'R', 'T', 'G', 'J', 'R', 'N', 'L', '\0'};
+    std::uint32_t version = 2;
+    std::uint32_t recordSize = sizeof(JournalRecord);
+};
+
+class SessionJournal {
+public:
+    SessionJournal(bool useJournalIn, bool keepPrevious = false): useJournal(useJournalIn && !replaying()) {
+        /* keepPrevious moves the last session's journal aside, rather than overwriting it */
+        if (!useJournal) return;
+
+        if (keepPrevious) keepPreviousJournal();
+        ring.resize(ringSize);
+        file.open(journalFile, std::ios_base::binary | std::ios_base::trunc);
+        JournalHeader header;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        writer = std::thread([this] { writeLoop(); });
+    }
+    ~SessionJournal() {
+        if (!useJournal) return;
+        running.store(false, std::memory_order_release);
+        writer.join();
+    }
+    SessionJournal(const SessionJournal&) = delete;
+    SessionJournal &operator=(const SessionJournal&) = delete;
+
+    static bool &replaying() {
+        /* set by the journal player before it constructs a trader. While replaying, we take our time from the
+         * journal, keep outbound messages in memory to be checked, and write nothing to disk */
+        static bool replayingFlag = false;
+        return replayingFlag;
+    }
+
+    /* Inbound callbacks. Each returns the timestamp of the event, which the trader uses as its clock */
+    std::int64_t recordBook(JournalEvent event, ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+                            const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                            const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                            const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                            const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+        JournalRecord record = makeRecord(event);
+        record.instrument = (std::uint8_t) instrument;
+        record.id = sequenceNumber;
+        std::copy(askPrices.begin(), askPrices.end(), record.askPrices.begin());
+        std::copy(askVolumes.begin(), askVolumes.end(), record.askVolumes.begin());
+        std::copy(bidPrices.begin(), bidPrices.end(), record.bidPrices.begin());
+        std::copy(bidVolumes.begin(), bidVolumes.end(), record.bidVolumes.begin());
+        return push(record);
+    }
+    std::int64_t recordFill(JournalEvent event, unsigned long clientOrderId, unsigned long price, unsigned long volume) {
+        JournalRecord record = makeRecord(event);
+        record.id = clientOrderId;
+        record.price = price;
+        record.volume = volume;
+        return push(record);
+    }
+    std::int64_t recordStatus(unsigned long clientOrderId, unsigned long fillVolume, unsigned long remainingVolume, signed long fees) {
+        JournalRecord record = makeRecord(JournalEvent::OrderStatus);
+        record.id = clientOrderId;
+        record.volume = fillVolume;
+        record.remainingVolume = remainingVolume;
+        record.fees = fees;
+        return push(record);
+    }
+    std::int64_t recordError(unsigned long clientOrderId, const std::string &errorMessage) {
+        JournalRecord record = makeRecord(JournalEvent::Error);
+        record.id = clientOrderId;
+        std::strncpy(record.message, errorMessage.c_str(), sizeof(record.message) - 1);
+        return push(record);
+    }
+    std::int64_t recordDisconnect() {
+        return push(makeRecord(JournalEvent::Disconnect));
+    }
+
+    /* Parameters, each time the trader adopts a new block from a parameter store */
+    void recordParams(const std::string &path, const StrategyParams &params) {
+        JournalRecord record = makeRecord(JournalEvent::Params);
+        record.id = params.generation;
+        std::strncpy(record.message, path.c_str(), sizeof(record.message) - 1);
+        for (std::size_t i = 0; i < std::size(strategyParamFields); i++)
+            record.paramSlot(i) = (std::uint64_t) (params.*strategyParamFields[i].field);
+        push(record);
+    }
+
+    /* Outbound messages */
+    void recordInsert(unsigned long clientOrderId, ReadyTraderGo::Side side, unsigned long price, unsigned long volume,
+                      ReadyTraderGo::Lifespan lifespan) {
+        JournalRecord record = makeRecord(JournalEvent::InsertOrder);
+        record.instrument = (std::uint8_t) ReadyTraderGo::Instrument::ETF;
+        record.id = clientOrderId;
+        record.side = (std::uint8_t) side;
+        record.price = price;
+        record.volume = volume;
+        record.lifespan = (std::uint8_t) lifespan;
+        push(record);
+    }
+    void recordHedge(unsigned long clientOrderId, ReadyTraderGo::Side side, unsigned long price, unsigned long volume) {
+        JournalRecord record = makeRecord(JournalEvent::HedgeOrder);
+        record.instrument = (std::uint8_t) ReadyTraderGo::Instrument::FUTURE;
+        record.id = clientOrderId;
+        record.side = (std::uint8_t) side;
+        record.price = price;
+        record.volume = volume;
+        push(record);
+    }
+    void recordCancel(unsigned long clientOrderId) {
+        JournalRecord record = makeRecord(JournalEvent::CancelOrder);
+        record.id = clientOrderId;
+        push(record);
+    }
+
+    static std::int64_t clockTime() {
+        /* the time live records are stamped with. Steady clock, so it restarts when the machine does */
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Replay */
+    void setReplayTime(std::int64_t timestamp) {
+        replayTime = timestamp;
+    }
+    const std::vector<JournalRecord> &getReplayedOutbound() const {
+        return replayedOutbound;
+    }
+
+    std::uint64_t getNextIndex() const {
+        return nextIndex;
+    }
+    void setNextIndex(std::uint64_t index) {
+        /* used when we restore from a checkpoint, so the journal carries on from where the checkpoint was taken */
+        nextIndex = index;
+    }
+
+    std::thread &getWriter() {
+        /* not joinable if we aren't journaling */
+        return writer;
+    }
+
+    unsigned long getDropped() const {
+        /* records we couldn't fit in the ring. If this isn't zero, the journal can't be replayed exactly */
+        return dropped;
+    }
+
+    bool writeCheckpoint(std::vector<char> buffer, const std::string &path, const std::string &latestPath) {
+        /* Hands a serialised checkpoint to the writer thread, which writes it to path, copies it to latestPath, and
+         * deletes all but the last few it wrote. If the last one hasn't been written yet, this one replaces it.
+         * Returns false if there's no writer thread, when it's up to the caller to write it */
+        if (!useJournal) return false;
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        pendingCheckpoint.buffer = std::move(buffer);
+        pendingCheckpoint.path = path;
+        pendingCheckpoint.latestPath = latestPath;
+        checkpointPending.store(true, std::memory_order_release);
+        return true;
+    }
+private:
+    static constexpr std::size_t ringSize = 1 << 16; // power of two, so we can mask rather than mod
+    const std::string journalFile = "custom_log/journal.bin";
+
+    bool useJournal;
+    std::ofstream file;
+    std::thread writer;
+    std::atomic<bool> running = true;
+
+    // single producer (the trading thread), single consumer (the writer thread)
+    std::vector<JournalRecord> ring;
+    std::atomic<std::size_t> head = 0, tail = 0;
+    std::uint64_t nextIndex = 0;
+    unsigned long dropped = 0;
+
+    std::int64_t replayTime = 0;
+    std::vector<JournalRecord> replayedOutbound;
+
+    // checkpoints waiting for the writer thread, and the ones it has written
+    struct PendingCheckpoint {
+        std::vector<char> buffer;
+        std::string path, latestPath;
+    };
+    static constexpr std::size_t checkpointsKept = 5;
+    std::mutex checkpointMutex;
+    PendingCheckpoint pendingCheckpoint;
+    std::atomic<bool> checkpointPending = false;
+    std::deque<std::string> writtenCheckpoints;
+
+    JournalRecord makeRecord(JournalEvent event) {
+        JournalRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.event = event;
+        record.timestamp = replaying() ? replayTime : clockTime();
+        return record;
+    }
+    std::int64_t push(JournalRecord record) {
+        /* copies the record into the ring. We never block the trading thread, so if the writer has fallen a whole
+         * ring behind we drop the record */
+        record.index = nextIndex ++;
+        if (replaying() && record.isOutbound()) replayedOutbound.emplace_back(record);
+        if (!useJournal) return record.timestamp;
+
+        std::size_t currHead = head.load(std::memory_order_relaxed);
+        if (currHead - tail.load(std::memory_order_acquire) == ringSize) {
+            dropped ++;
+            return record.timestamp;
+        }
+        ring[currHead & (ringSize - 1)] = record;
+        head.store(currHead + 1, std::memory_order_release);
+        return record.timestamp;
+    }
+    void keepPreviousJournal() {
+        /* renames the journal to the first free journal_<n>.bin */
+        std::error_code error;
+        if (!std::filesystem::exists(journalFile, error)) return;
+        std::string stem = journalFile.substr(0, journalFile.size() - 4);
+        for (int n = 1; ; n++) {
+            std::string previous = stem + "_" + std::to_string(n) + ".bin";
+            if (std::filesystem::exists(previous, error)) continue;
+            std::filesystem::rename(journalFile, previous, error);
+            return;
+        }
+    }
+    void writeLoop() {
+        /* drains the ring to disk until we're destroyed, then drains it one last time */
+        while (true) {
+            bool stopping = !running.load(std::memory_order_acquire);
+
+            std::size_t currTail = tail.load(std::memory_order_relaxed);
+            std::size_t currHead = head.load(std::memory_order_acquire);
+            for (; currTail != currHead; currTail ++)
+                file.write(reinterpret_cast<const char*>(&ring[currTail & (ringSize - 1)]), sizeof(JournalRecord));
+            tail.store(currTail, std::memory_order_release);
+            if (checkpointPending.load(std::memory_order_acquire)) writePendingCheckpoint();
+
+            if (stopping) break;
+            file.flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        file.close();
+    }
+    void writePendingCheckpoint() {
+        PendingCheckpoint checkpoint;
+        {
+            std::lock_guard<std::mutex> lock(checkpointMutex);
+            std::swap(checkpoint, pendingCheckpoint);
+            checkpointPending.store(false, std::memory_order_relaxed);
+        }
+        if (!writeCheckpointFile(checkpoint.path, checkpoint.buffer)) return;
+
+        // copy rather than write again, renaming so the latest is never half written
+        std::error_code error;
+        std::string tempPath = checkpoint.latestPath + ".tmp";
+        std::filesystem::copy_file(checkpoint.path, tempPath, std::filesystem::copy_options::overwrite_existing, error);
+        if (!error) std::filesystem::rename(tempPath, checkpoint.latestPath, error);
+
+        writtenCheckpoints.push_back(checkpoint.path);
+        while (writtenCheckpoints.size() > checkpointsKept) {
+            std::filesystem::remove(writtenCheckpoints.front(), error);
+            writtenCheckpoints.pop_front();
+        }
+    }
+};
+
+static inline std::vector<JournalRecord> readJournal(const std::string &path) {
+    /* reads every record in a journal file. Returns nothing if the file isn't a journal */
+    std::vector<JournalRecord> records;
+    std::ifstream file(path, std::ios_base::binary);
+
+    JournalHeader header, expected;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return records;
+    if ((std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) || (header.version != expected.version) ||
+        (header.recordSize != expected.recordSize))
+        return records;
+
+    JournalRecord record;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) records.emplace_back(record);
+    return records;
+}
+
+static inline StrategyParams readParams(const JournalRecord &record) {
+    /* the parameters a Params record holds */
+    StrategyParams params;
+    params.generation = record.id;
+    for (std::size_t i = 0; i < std::size(strategyParamFields); i++)
+        params.*strategyParamFields[i].field = (long) record.paramSlot(i);
+    return params;
+}
+
+#endif //READY_TRADER_GO_2024_JOURNAL_H
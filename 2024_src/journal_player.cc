@@ -0,0 +1,56 @@
+//
+// Replays a session journal through a fresh AutoTrader, and checks it sends exactly the messages it sent live.
+// Usage: journal_player [journal file] [checkpoint file]
+// If a checkpoint is given, we restore it and replay from the point it was taken.
+// A warm started session's journal only replays from the checkpoint_warm_<n>.bin it started from.
+//
+
+#include <algorithm>
+#include <iostream>
+#include <boost/asio/io_context.hpp>
+#include "replay.h"
+
+int main(int argc, char *argv[]) {
+    std::string path = argc > 1 ? argv[1] : "custom_log/journal.bin";
+    std::vector<JournalRecord> records = readJournal(path);
+    if (records.empty()) {
+        std::cerr << "no records in " << path << std::endl;
+        return 1;
+    }
+
+    /* Feed every inbound record to the trader, at the time it was received */
+    SessionJournal::replaying() = true;
+    boost::asio::io_context context;
+    AutoTrader trader(context);
+    if ((argc > 2) && !trader.loadCheckpoint(argv[2])) {
+        std::cerr << "failed to load checkpoint " << argv[2] << std::endl;
+        return 1;
+    }
+    std::uint64_t startIndex = trader.getJournal().getNextIndex();
+    std::vector<JournalRecord> recordedOutbound = replayRecords(trader, records);
+    bool disconnected = std::any_of(records.begin(), records.end(),
+                                    [](const JournalRecord &record) { return record.event == JournalEvent::Disconnect; });
+
+    // the counters are printed on disconnect, so print them ourselves if the session was cut short
+    if (!disconnected) trader.getProfiler().print();
+
+    /* Check the trader sent the same messages, in the same order */
+    const std::vector<JournalRecord> &replayedOutbound = trader.getJournal().getReplayedOutbound();
+    std::size_t count = std::min(recordedOutbound.size(), replayedOutbound.size());
+    for (std::size_t i = 0; i < count; i ++) {
+        if (!sameMessage(recordedOutbound[i], replayedOutbound[i])) {
+            std::cout << "outbound message " << i << " differs: recorded order " << recordedOutbound[i].id
+                      << " at journal index " << recordedOutbound[i].index << ", replayed order " << replayedOutbound[i].id << std::endl;
+            return 1;
+        }
+    }
+    if (recordedOutbound.size() != replayedOutbound.size()) {
+        std::cout << "recorded " << recordedOutbound.size() << " outbound messages, but replayed "
+                  << replayedOutbound.size() << std::endl;
+        return 1;
+    }
+
+    std::cout << "replayed from journal index " << startIndex << ", all "
+              << replayedOutbound.size() << " outbound messages match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,144 @@
+//
+// Drives an AutoTrader with a synthetic feed at many times the live rate, to find where it starts to fall behind.
+// Usage: load_test [speedup] [sequences]
+// e.g. load_test 1000 20000 sends 4000 books a second. We aren't connected to an exchange, so outbound messages are
+// kept in memory (as in a replay), and answered here: cancels are acknowledged, hedges fill straight away, and
+// resting orders fill when a trade tick trades through their price.
+//
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sys/resource.h>
+#include <boost/asio/io_context.hpp>
+#include "autotrader.h"
+#include "market_generator.h"
+
+struct RestingOrder {
+    Side side;
+    unsigned long price, remaining;
+};
+
+class SimulatedFills {
+    /* Answers the trader's outbound messages, crudely */
+public:
+    SimulatedFills(AutoTrader &traderIn): trader(traderIn) {}
+
+    void answerOutbound() {
+        const std::vector<JournalRecord> &outbound = trader.getJournal().getReplayedOutbound();
+        while (answered < outbound.size()) {
+            JournalRecord record = outbound[answered++];
+            switch (record.event) {
+                case JournalEvent::InsertOrder:
+                    resting[record.id] = {(Side) record.side, record.price, record.volume};
+                    break;
+                case JournalEvent::HedgeOrder:
+                    trader.HedgeFilledMessageHandler(record.id, record.price, record.volume);
+                    break;
+                case JournalEvent::CancelOrder: {
+                    auto order = resting.find(record.id);
+                    if (order == resting.end()) break;
+                    resting.erase(order);
+                    trader.OrderStatusMessageHandler(record.id, 0, 0, 0);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+    void onTradeTicks(const MarketEvent &ticks) {
+        /* buyers lifting asks up to a price fill our asks at or below it, and likewise for sellers and our bids */
+        unsigned long highestAsk = 0, lowestBid = 0;
+        for (int i = 0; i < TOP_LEVEL_COUNT; i++) {
+            if (ticks.askVolumes[i] > 0) highestAsk = std::max(highestAsk, ticks.askPrices[i]);
+            if (ticks.bidVolumes[i] > 0) lowestBid = lowestBid == 0 ? ticks.bidPrices[i] : std::min(lowestBid, ticks.bidPrices[i]);
+        }
+
+        std::vector<unsigned long> filled;
+        for (auto &pair: resting) {
+            RestingOrder &order = pair.second;
+            bool tradedThrough = order.side == Side::SELL ? (highestAsk != 0) && (order.price <= highestAsk)
+                                                          : (lowestBid != 0) && (order.price >= lowestBid);
+            if (tradedThrough) filled.push_back(pair.first);
+        }
+        for (unsigned long clientOrderID: filled) {
+            RestingOrder order = resting[clientOrderID];
+            resting.erase(clientOrderID);
+            trader.OrderFilledMessageHandler(clientOrderID, order.price, order.remaining);
+            trader.OrderStatusMessageHandler(clientOrderID, order.remaining, 0, 0);
+        }
+    }
+private:
+    AutoTrader &trader;
+    std::size_t answered = 0;
+    std::map<unsigned long, RestingOrder> resting;
+};
+
+int main(int argc, char *argv[]) {
+    static const int phases = 4; // we report latency per quarter of the run, to see if it degrades as we go
+
+    MarketGeneratorConfig config;
+    config.speedup = argc > 1 ? std::stod(argv[1]) : 100;
+    unsigned long sequences = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+    SessionJournal::replaying() = true;
+    boost::asio::io_context context;
+    AutoTrader trader(context);
+    SimulatedFills fills(trader);
+    MarketGenerator generator(config);
+
+    LatencyHistogram handlerLatency[phases], lag;
+    std::int64_t maxHandlerLatency = 0, maxLag = 0;
+    unsigned long events = 0, lateEvents = 0;
+    const std::int64_t liveInterval = (std::int64_t) (0.25e9 / config.speedup);
+
+    auto start = std::chrono::steady_clock::now();
+    MarketEvent event;
+    while (generator.next(event) && (event.sequenceNumber <= sequences)) {
+        /* Wait until the event is due. If we're behind, deliver it straight away */
+        auto due = start + std::chrono::nanoseconds(event.deliveryTime);
+        while (std::chrono::steady_clock::now() < due);
+
+        auto handlerStart = std::chrono::steady_clock::now();
+        trader.getJournal().setReplayTime(event.deliveryTime);
+        if (event.type == MarketEventType::OrderBook) {
+            trader.OrderBookMessageHandler(event.instrument, event.sequenceNumber, event.askPrices, event.askVolumes,
+                                           event.bidPrices, event.bidVolumes);
+        } else {
+            trader.TradeTicksMessageHandler(event.instrument, event.sequenceNumber, event.askPrices, event.askVolumes,
+                                            event.bidPrices, event.bidVolumes);
+            if (event.instrument == Instrument::ETF) fills.onTradeTicks(event);
+        }
+        fills.answerOutbound();
+        auto handlerEnd = std::chrono::steady_clock::now();
+
+        /* How long we took, and how late we finished */
+        std::int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(handlerEnd - handlerStart).count();
+        std::int64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(handlerEnd - due).count();
+        handlerLatency[std::min<unsigned long>(phases - 1, phases * (event.sequenceNumber - 1) / sequences)].record(latency);
+        lag.record(late);
+        maxHandlerLatency = std::max(maxHandlerLatency, latency);
+        maxLag = std::max(maxLag, late);
+        if (late > liveInterval) lateEvents ++;
+        events ++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << "------=+ Load test at " << config.speedup << "x live +=------" << std::endl
+              << "    - " << events << " events over " << sequences << " sequences in " << seconds << "s = "
+              << events / seconds << " events/s (" << sequences / seconds << " sequences/s, live is 4/s)" << std::endl;
+    for (int phase = 0; phase < phases; phase++)
+        std::cout << "    - Handler latency, quarter " << phase + 1 << " (ns): p50 = " << handlerLatency[phase].percentile(0.5)
+                  << ", p99 = " << handlerLatency[phase].percentile(0.99) << ", p99.9 = " << handlerLatency[phase].percentile(0.999) << std::endl;
+    std::cout << "    - Max handler latency = " << maxHandlerLatency << "ns" << std::endl
+              << "    - Finished behind schedule (ns): p50 = " << lag.percentile(0.5) << ", p99 = " << lag.percentile(0.99)
+              << ", max = " << maxLag << std::endl
+              << "    - Events finished more than a sequence late = " << 100.0 * lateEvents / events << "%" << std::endl
+              << "    - Waited on the analytics thread " << trader.getAnalytics().getStalls() << " times" << std::endl
+              << "    - Peak memory = " << usage.ru_maxrss / 1024 << "MB" << std::endl;
+    return lateEvents > events / 100 ? 1 : 0;
+}
@@ -0,0 +1,429 @@
+//
+// A stand-in for the ReadyTraderGo exchange, on loopback, so the unmodified trader binary can be measured wire to wire.
+// Usage: loopback_exchange [--journal file | --synthetic] [--speedup x] [--sequences n] [--port p] [--info-port p]
+//
+// Books and trade ticks come from a session journal, or from the synthetic generator, and are sent as UDP datagrams
+// to the information port. The trader connects to the execution port over TCP, and we match its orders against the
+// books we've sent. Every message in and out is timestamped into custom_log/exchange_wire.csv, and on exit we print
+// the time from each book going out to the trader's first reply to it.
+//
+// Point autotrader.json at 127.0.0.1 with the same ports, and the information channel at UDP rather than mmap.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <ready_trader_go/types.h>
+#include "exchange_protocol.h"
+#include "journal.h"
+#include "market_generator.h"
+#include "telemetry.h"
+
+using namespace ReadyTraderGo;
+
+typedef std::array<unsigned long, TOP_LEVEL_COUNT> Levels;
+
+static std::int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class MarketSource {
+    /* The books to send: a recorded session, or the synthetic feed */
+public:
+    MarketSource(const std::string &journalPath, MarketGeneratorConfig config, unsigned long sequencesIn):
+        generator(config), speedup(config.speedup), sequences(sequencesIn) {
+        if (journalPath.empty()) return;
+        for (const JournalRecord &record: readJournal(journalPath))
+            if ((record.event == JournalEvent::OrderBook) || (record.event == JournalEvent::TradeTicks))
+                recorded.push_back(record);
+        useJournal = true;
+    }
+    bool next(MarketEvent &event) {
+        if (!useJournal) return generator.next(event) && (event.sequenceNumber <= sequences);
+        if (position == recorded.size()) return false;
+
+        const JournalRecord &record = recorded[position++];
+        event.type = record.event == JournalEvent::OrderBook ? MarketEventType::OrderBook : MarketEventType::TradeTicks;
+        event.instrument = (Instrument) record.instrument;
+        event.sequenceNumber = record.id;
+        event.deliveryTime = (std::int64_t) ((record.timestamp - recorded.front().timestamp) / speedup);
+        std::copy(record.askPrices.begin(), record.askPrices.end(), event.askPrices.begin());
+        std::copy(record.askVolumes.begin(), record.askVolumes.end(), event.askVolumes.begin());
+        std::copy(record.bidPrices.begin(), record.bidPrices.end(), event.bidPrices.begin());
+        std::copy(record.bidVolumes.begin(), record.bidVolumes.end(), event.bidVolumes.begin());
+        return event.sequenceNumber <= sequences;
+    }
+private:
+    MarketGenerator generator;
+    double speedup;
+    unsigned long sequences;
+    bool useJournal = false;
+    std::vector<JournalRecord> recorded;
+    std::size_t position = 0;
+};
+
+struct RestingOrder {
+    Side side;
+    unsigned long price, remaining, filled;
+    long fees;
+};
+
+class LoopbackExchange {
+public:
+    LoopbackExchange(int executionPort, int infoPort): wireLog("custom_log/exchange_wire.csv") {
+        wireLog << "time_ns,direction,type,id" << std::endl;
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int enable = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in address = makeAddress(executionPort);
+        if ((bind(listener, (sockaddr*) &address, sizeof(address)) != 0) || (listen(listener, 1) != 0))
+            throw std::runtime_error("couldn't listen on port " + std::to_string(executionPort));
+
+        info = socket(AF_INET, SOCK_DGRAM, 0);
+        infoAddress = makeAddress(infoPort);
+    }
+    ~LoopbackExchange() {
+        if (connection >= 0) close(connection);
+        close(listener);
+        close(info);
+    }
+
+    void acceptTrader() {
+        std::cout << "waiting for the trader to connect" << std::endl;
+        connection = accept(listener, nullptr, nullptr);
+        int enable = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+    void run(MarketSource &source) {
+        /* Sends each book when it's due, and handles the trader's messages in between */
+        static const std::int64_t drainTime = 1000000000; // how long we wait for the trader's last messages
+
+        MarketEvent event;
+        bool haveEvent = source.next(event);
+        std::int64_t start = nowNanos(), finishedAt = 0;
+        while (connected) {
+            std::int64_t now = nowNanos();
+            if (haveEvent && (now - start >= event.deliveryTime)) {
+                publish(event);
+                haveEvent = source.next(event);
+                if (!haveEvent) finishedAt = nowNanos();
+                continue;
+            }
+            if (!haveEvent && (now - finishedAt > drainTime)) break;
+
+            // wait for the trader until the next book is due
+            std::int64_t wait = haveEvent ? event.deliveryTime - (now - start) : drainTime;
+            timespec timeout = {(time_t) (wait / 1000000000), (long) (wait % 1000000000)};
+            pollfd descriptor = {connection, POLLIN, 0};
+            if (ppoll(&descriptor, 1, &timeout, nullptr) > 0) receive();
+        }
+    }
+    void printSummary() const {
+        std::cout << "------=+ Loopback exchange +=------" << std::endl
+                  << "    - Sent " << booksSent << " books and trade ticks, received " << messagesReceived
+                  << " messages, sent " << messagesSent << " replies" << std::endl
+                  << "    - Book to first reply (ns): p50 = " << wireToWire.percentile(0.5) << ", p90 = "
+                  << wireToWire.percentile(0.9) << ", p99 = " << wireToWire.percentile(0.99) << ", over "
+                  << repliesTimed << " books" << std::endl
+                  << "    - " << lotsTraded << " ETF lots and " << hedgeLotsTraded << " hedge lots traded" << std::endl;
+    }
+private:
+    int listener = -1, connection = -1, info = -1;
+    sockaddr_in infoAddress;
+    bool connected = true, loggedIn = false;
+    std::vector<std::uint8_t> inbound;
+    std::ofstream wireLog;
+
+    /* The market as we last published it */
+    Levels etfAskPrices = {}, etfAskVolumes = {}, etfBidPrices = {}, etfBidVolumes = {};
+    Levels futureAskPrices = {}, futureAskVolumes = {}, futureBidPrices = {}, futureBidVolumes = {};
+    std::map<unsigned long, RestingOrder> resting;
+
+    /* Measurements */
+    std::int64_t lastPublished = 0; // when we sent the last book, 0 once the trader has replied to it
+    LatencyHistogram wireToWire;
+    unsigned long booksSent = 0, messagesReceived = 0, messagesSent = 0, repliesTimed = 0;
+    long lotsTraded = 0, hedgeLotsTraded = 0;
+
+    static sockaddr_in makeAddress(int port) {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons((std::uint16_t) port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return address;
+    }
+
+    /* Information channel */
+    void publish(const MarketEvent &event) {
+        WireWriter writer(event.type == MarketEventType::OrderBook ? WireMessageType::OrderBookUpdate : WireMessageType::TradeTicks);
+        writer.put8((std::uint8_t) event.instrument).put32((std::uint32_t) event.sequenceNumber);
+        for (const Levels *levels: {&event.askPrices, &event.askVolumes, &event.bidPrices, &event.bidVolumes})
+            for (unsigned long value: *levels) writer.put32((std::uint32_t) value);
+        const std::uint8_t *message = writer.finish();
+
+        // the book is live before the trader can see it
+        if (event.type == MarketEventType::OrderBook) {
+            bool isEtf = event.instrument == Instrument::ETF;
+            (isEtf ? etfAskPrices : futureAskPrices) = event.askPrices;
+            (isEtf ? etfAskVolumes : futureAskVolumes) = event.askVolumes;
+            (isEtf ? etfBidPrices : futureBidPrices) = event.bidPrices;
+            (isEtf ? etfBidVolumes : futureBidVolumes) = event.bidVolumes;
+        } else if (event.instrument == Instrument::ETF) {
+            fillAgainstTrades(event);
+        }
+
+        std::int64_t sentAt = nowNanos();
+        sendto(info, message, writer.getSize(), 0, (sockaddr*) &infoAddress, sizeof(infoAddress));
+        logWire(sentAt, "info", event.type == MarketEventType::OrderBook ? WireMessageType::OrderBookUpdate : WireMessageType::TradeTicks,
+                event.sequenceNumber);
+        booksSent ++;
+        if (event.type == MarketEventType::OrderBook) lastPublished = sentAt;
+    }
+
+    /* Execution channel */
+    void receive() {
+        std::uint8_t buffer[4096];
+        ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+        std::int64_t receivedAt = nowNanos();
+        if (received <= 0) {
+            std::cout << "trader disconnected" << std::endl;
+            connected = false;
+            return;
+        }
+        inbound.insert(inbound.end(), buffer, buffer + received);
+
+        std::size_t position = 0;
+        while (inbound.size() - position >= wireHeaderSize) {
+            std::size_t length = WireReader::getLength(&inbound[position]);
+            WireMessageType type = WireReader::getType(&inbound[position]);
+            if (length != getWireMessageSize(type)) {
+                std::cerr << "malformed message of type " << (int) type << ", length " << length << std::endl;
+                connected = false;
+                return;
+            }
+            if (inbound.size() - position < length) break;
+            handle(&inbound[position], receivedAt);
+            position += length;
+        }
+        inbound.erase(inbound.begin(), inbound.begin() + position);
+    }
+    void handle(const std::uint8_t *message, std::int64_t receivedAt) {
+        WireReader reader(message);
+        WireMessageType type = WireReader::getType(message);
+        messagesReceived ++;
+
+        if (type == WireMessageType::Login) {
+            std::string name = reader.getString(wireLoginFieldLength);
+            loggedIn = true;
+            logWire(receivedAt, "in", type, 0);
+            std::cout << name << " logged in" << std::endl;
+            return;
+        }
+
+        unsigned long clientOrderID = reader.get32();
+        logWire(receivedAt, "in", type, clientOrderID);
+        if (lastPublished != 0) {
+            wireToWire.record(receivedAt - lastPublished);
+            repliesTimed ++;
+            lastPublished = 0;
+        }
+        if (!loggedIn) {
+            sendError(clientOrderID, "not logged in");
+            return;
+        }
+
+        switch (type) {
+            case WireMessageType::InsertOrder: {
+                Side side = (Side) reader.get8();
+                unsigned long price = reader.get32(), volume = reader.get32();
+                Lifespan lifespan = (Lifespan) reader.get8();
+                insertOrder(clientOrderID, side, price, volume, lifespan);
+                break;
+            }
+            case WireMessageType::HedgeOrder: {
+                Side side = (Side) reader.get8();
+                unsigned long price = reader.get32(), volume = reader.get32();
+                hedgeOrder(clientOrderID, side, price, volume);
+                break;
+            }
+            case WireMessageType::CancelOrder: {
+                auto order = resting.find(clientOrderID);
+                if (order == resting.end()) break; // already filled or cancelled
+                sendStatus(clientOrderID, order->second.filled, 0, order->second.fees);
+                resting.erase(order);
+                break;
+            }
+            case WireMessageType::AmendOrder: {
+                unsigned long volume = reader.get32();
+                auto order = resting.find(clientOrderID);
+                if (order == resting.end()) break;
+                RestingOrder &amended = order->second;
+                if (volume < amended.filled + amended.remaining)
+                    amended.remaining = volume > amended.filled ? volume - amended.filled : 0;
+                sendStatus(clientOrderID, amended.filled, amended.remaining, amended.fees);
+                if (amended.remaining == 0) resting.erase(order);
+                break;
+            }
+            default:
+                sendError(clientOrderID, "unexpected message type");
+                break;
+        }
+    }
+
+    /* Matching */
+    void insertOrder(unsigned long clientOrderID, Side side, unsigned long price, unsigned long volume, Lifespan lifespan) {
+        /* Takes what it can from the ETF book as it was last published, then rests the rest if it's good for day */
+        static const double takerFee = 0.0002;
+        static const unsigned long tickSize = 100;
+        if ((volume == 0) || (price % tickSize != 0) || (resting.count(clientOrderID) != 0)) {
+            sendError(clientOrderID, "invalid order");
+            return;
+        }
+
+        RestingOrder order = {side, price, volume, 0, 0};
+        Levels &prices = side == Side::BUY ? etfAskPrices : etfBidPrices;
+        Levels &volumes = side == Side::BUY ? etfAskVolumes : etfBidVolumes;
+        for (int i = 0; (i < TOP_LEVEL_COUNT) && (order.remaining > 0); i++) {
+            bool crosses = (prices[i] != 0) && (volumes[i] > 0) &&
+                           (side == Side::BUY ? prices[i] <= price : prices[i] >= price);
+            if (!crosses) break;
+
+            unsigned long traded = std::min(order.remaining, volumes[i]);
+            volumes[i] -= traded;
+            fill(clientOrderID, order, prices[i], traded, takerFee);
+        }
+
+        if ((order.remaining > 0) && (lifespan == Lifespan::GOOD_FOR_DAY)) {
+            resting[clientOrderID] = order;
+            sendStatus(clientOrderID, order.filled, order.remaining, order.fees);
+        } else {
+            sendStatus(clientOrderID, order.filled, 0, order.fees);
+        }
+    }
+    void hedgeOrder(unsigned long clientOrderID, Side side, unsigned long price, unsigned long volume) {
+        /* Hedges fill at the volume weighted price of the futures book, if that's within the limit price */
+        Levels &prices = side == Side::BUY ? futureAskPrices : futureBidPrices;
+        Levels &volumes = side == Side::BUY ? futureAskVolumes : futureBidVolumes;
+        unsigned long remaining = volume;
+        double notional = 0;
+        for (int i = 0; (i < TOP_LEVEL_COUNT) && (remaining > 0); i++) {
+            unsigned long traded = std::min(remaining, volumes[i]);
+            notional += (double) traded * prices[i];
+            remaining -= traded;
+        }
+        unsigned long traded = volume - remaining;
+        unsigned long averagePrice = traded == 0 ? 0 : (unsigned long) std::lround(notional / traded);
+        bool withinLimit = side == Side::BUY ? averagePrice <= price : averagePrice >= price;
+        if ((traded == 0) || !withinLimit) {
+            sendHedgeFilled(clientOrderID, 0, 0);
+            return;
+        }
+        hedgeLotsTraded += traded;
+        sendHedgeFilled(clientOrderID, averagePrice, traded);
+    }
+    void fillAgainstTrades(const MarketEvent &ticks) {
+        /* Trade ticks at or through a resting order's price fill it, at its price */
+        static const double makerFee = -0.0001;
+        for (auto order = resting.begin(); order != resting.end();) {
+            RestingOrder &restingOrder = order->second;
+            bool isBid = restingOrder.side == Side::BUY;
+            const Levels &prices = isBid ? ticks.bidPrices : ticks.askPrices;
+            const Levels &volumes = isBid ? ticks.bidVolumes : ticks.askVolumes;
+
+            unsigned long tradedThrough = 0;
+            for (int i = 0; i < TOP_LEVEL_COUNT; i++) {
+                if ((volumes[i] == 0) || (prices[i] == 0)) continue;
+                if (isBid ? prices[i] <= restingOrder.price : prices[i] >= restingOrder.price) tradedThrough += volumes[i];
+            }
+            if (tradedThrough == 0) {
+                order++;
+                continue;
+            }
+
+            unsigned long traded = std::min(tradedThrough, restingOrder.remaining);
+            fill(order->first, restingOrder, restingOrder.price, traded, makerFee);
+            sendStatus(order->first, restingOrder.filled, restingOrder.remaining, restingOrder.fees);
+            order = restingOrder.remaining == 0 ? resting.erase(order) : std::next(order);
+        }
+    }
+    void fill(unsigned long clientOrderID, RestingOrder &order, unsigned long price, unsigned long volume, double feeRate) {
+        order.remaining -= volume;
+        order.filled += volume;
+        order.fees += (long) std::lround(feeRate * (double) price * volume);
+        lotsTraded += volume;
+        sendFilled(clientOrderID, price, volume);
+    }
+
+    /* Replies */
+    void sendFilled(unsigned long clientOrderID, unsigned long price, unsigned long volume) {
+        WireWriter writer(WireMessageType::OrderFilled);
+        writer.put32((std::uint32_t) clientOrderID).put32((std::uint32_t) price).put32((std::uint32_t) volume);
+        send(writer, clientOrderID);
+    }
+    void sendHedgeFilled(unsigned long clientOrderID, unsigned long price, unsigned long volume) {
+        WireWriter writer(WireMessageType::HedgeFilled);
+        writer.put32((std::uint32_t) clientOrderID).put32((std::uint32_t) price).put32((std::uint32_t) volume);
+        send(writer, clientOrderID);
+    }
+    void sendStatus(unsigned long clientOrderID, unsigned long filled, unsigned long remaining, long fees) {
+        WireWriter writer(WireMessageType::OrderStatus);
+        writer.put32((std::uint32_t) clientOrderID).put32((std::uint32_t) filled).put32((std::uint32_t) remaining)
+              .put32((std::uint32_t) (std::int32_t) fees);
+        send(writer, clientOrderID);
+    }
+    void sendError(unsigned long clientOrderID, const std::string &error) {
+        WireWriter writer(WireMessageType::Error);
+        writer.put32((std::uint32_t) clientOrderID).putString(error, wireErrorLength);
+        send(writer, clientOrderID);
+    }
+    void send(WireWriter &writer, unsigned long clientOrderID) {
+        const std::uint8_t *message = writer.finish();
+        if (::send(connection, message, writer.getSize(), MSG_NOSIGNAL) != (ssize_t) writer.getSize()) connected = false;
+        logWire(nowNanos(), "out", (WireMessageType) message[2], clientOrderID);
+        messagesSent ++;
+    }
+    void logWire(std::int64_t time, const char *direction, WireMessageType type, unsigned long id) {
+        wireLog << time << "," << direction << "," << (int) type << "," << id << "\n";
+    }
+};
+
+int main(int argc, char *argv[]) {
+    std::string journalPath;
+    MarketGeneratorConfig config;
+    unsigned long sequences = 10000;
+    int executionPort = 12345, infoPort = 12346;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--journal") && hasValue) journalPath = argv[++i];
+        else if (arg == "--synthetic") journalPath.clear();
+        else if ((arg == "--speedup") && hasValue) config.speedup = std::stod(argv[++i]);
+        else if ((arg == "--sequences") && hasValue) sequences = std::stoul(argv[++i]);
+        else if ((arg == "--port") && hasValue) executionPort = std::stoi(argv[++i]);
+        else if ((arg == "--info-port") && hasValue) infoPort = std::stoi(argv[++i]);
+        else {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    MarketSource source(journalPath, config, sequences);
+    LoopbackExchange exchange(executionPort, infoPort);
+    exchange.acceptTrader();
+    exchange.run(source);
+    exchange.printSummary();
+    return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef READY_TRADER_GO_2024_MARKET_GENERATOR_H
+#define READY_TRADER_GO_2024_MARKET_GENERATOR_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <ready_trader_go/types.h>
+
+/* A synthetic feed of futures and ETF books and trade ticks, so we can load test without recorded data.
+ *
+ * The futures mid is a random walk with occasional jumps. The ETF mid follows it a configurable number of sequences
+ * later, plus a little noise. Level volumes are drawn from a geometric distribution which deepens away from the
+ * touch. Each event is stamped with the time it should be delivered at, for a chosen speedup over the live cadence,
+ * and bursts compress the gaps between sequences further. */
+
+struct MarketGeneratorConfig {
+    unsigned int seed = 1;
+    double speedup = 1; // how many times faster than the live four books a second
+
+    /* Prices, in cents */
+    long tickSize = 100;
+    long startMid = 1000000;
+    double volatility = 1; // standard deviation of the futures mid per sequence, in ticks
+    double jumpProbability = 0.005; // chance per sequence of a jump
+    long jumpTicks = 10; // size of a jump
+    long etfLag = 1; // sequences the ETF mid trails the futures mid by
+    double etfNoise = 0.5; // standard deviation of the ETF mid around the lagged futures mid, in ticks
+    long etfSpreadTicks = 2, futureSpreadTicks = 1;
+
+    /* Volumes */
+    double meanTouchVolume = 40; // mean volume at the touch
+    double depthGrowth = 0.5; // each level deeper is this much fuller than the touch, on average
+
+    /* Trades */
+    double tradeProbability = 0.6; // chance per sequence per instrument of trade ticks
+    double meanTradeVolume = 15;
+
+    /* Bursts */
+    double burstProbability = 0.01; // chance per sequence of starting a burst
+    long burstLength = 50; // sequences in a burst
+    double burstSpeedup = 10; // how much faster sequences arrive during a burst
+};
+
+enum class MarketEventType : std::uint8_t {
+    OrderBook, TradeTicks
+};
+
+struct MarketEvent {
+    MarketEventType type;
+    ReadyTraderGo::Instrument instrument;
+    unsigned long sequenceNumber;
+    std::int64_t deliveryTime; // nanoseconds from the start of the feed
+    std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> askPrices, askVolumes, bidPrices, bidVolumes;
+};
+
+class MarketGenerator {
+public:
+    MarketGenerator(MarketGeneratorConfig configIn): config(configIn), rng(configIn.seed) {
+        futureMid = config.startMid;
+        pastFutureMids.assign(config.etfLag + 1, futureMid);
+    }
+
+    bool next(MarketEvent &event) {
+        /* Produces the next event. Each sequence is a futures book, an ETF book, then any trade ticks, as the exchange
+         * sends them. Always returns true, the feed never ends */
+        if (pending.empty()) generateSequence();
+        event = pending.front();
+        pending.pop_front();
+        return true;
+    }
+
+    long getFutureMid() const {
+        return futureMid;
+    }
+private:
+    MarketGeneratorConfig config;
+    std::mt19937_64 rng;
+    std::deque<MarketEvent> pending;
+
+    unsigned long sequenceNumber = 0;
+    double elapsed = 0; // nanoseconds
+    long futureMid;
+    std::deque<long> pastFutureMids; // the futures mid over the last etfLag sequences, oldest first
+    long burstRemaining = 0;
+
+    void generateSequence() {
+        static const double liveInterval = 0.25e9; // nanoseconds between sequences live
+
+        /* Move time on */
+        if ((burstRemaining == 0) && (uniform() < config.burstProbability)) burstRemaining = config.burstLength;
+        double interval = liveInterval / config.speedup;
+        if (burstRemaining > 0) {
+            interval /= config.burstSpeedup;
+            burstRemaining --;
+        }
+        elapsed += interval;
+        sequenceNumber ++;
+
+        /* Move the mids */
+        double move = std::normal_distribution<double>(0, config.volatility)(rng);
+        if (uniform() < config.jumpProbability) move += uniform() < 0.5 ? -config.jumpTicks : config.jumpTicks;
+        futureMid += (long) std::lround(move) * config.tickSize;
+        pastFutureMids.push_back(futureMid);
+        pastFutureMids.pop_front();
+
+        long etfMid = pastFutureMids.front() +
+                      (long) std::lround(std::normal_distribution<double>(0, config.etfNoise)(rng)) * config.tickSize;
+
+        /* The books, futures first */
+        std::int64_t deliveryTime = (std::int64_t) elapsed;
+        MarketEvent futureBook = makeBook(ReadyTraderGo::Instrument::FUTURE, futureMid, config.futureSpreadTicks, deliveryTime);
+        MarketEvent etfBook = makeBook(ReadyTraderGo::Instrument::ETF, etfMid, config.etfSpreadTicks, deliveryTime);
+        pending.push_back(futureBook);
+        pending.push_back(etfBook);
+
+        /* Then the trades */
+        if (uniform() < config.tradeProbability)
+            pending.push_back(makeTrades(ReadyTraderGo::Instrument::FUTURE, futureBook, deliveryTime));
+        if (uniform() < config.tradeProbability)
+            pending.push_back(makeTrades(ReadyTraderGo::Instrument::ETF, etfBook, deliveryTime));
+    }
+    MarketEvent makeBook(ReadyTraderGo::Instrument instrument, long mid, long spreadTicks, std::int64_t deliveryTime) {
+        MarketEvent event;
+        event.type = MarketEventType::OrderBook;
+        event.instrument = instrument;
+        event.sequenceNumber = sequenceNumber;
+        event.deliveryTime = deliveryTime;
+
+        // the best bid sits half the spread below the mid, on the tick grid
+        long bestBid = ((mid - spreadTicks * config.tickSize / 2) / config.tickSize) * config.tickSize;
+        long bestAsk = bestBid + spreadTicks * config.tickSize;
+        for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++) {
+            double meanVolume = config.meanTouchVolume * (1 + config.depthGrowth * i);
+            event.bidPrices[i] = (unsigned long) std::max(0L, bestBid - i * config.tickSize);
+            event.askPrices[i] = (unsigned long) (bestAsk + i * config.tickSize);
+            event.bidVolumes[i] = 1 + std::geometric_distribution<unsigned long>(1 / meanVolume)(rng);
+            event.askVolumes[i] = 1 + std::geometric_distribution<unsigned long>(1 / meanVolume)(rng);
+        }
+        return event;
+    }
+    MarketEvent makeTrades(ReadyTraderGo::Instrument instrument, const MarketEvent &book, std::int64_t deliveryTime) {
+        /* trades against the top of the given book, on one side */
+        MarketEvent event;
+        event.type = MarketEventType::TradeTicks;
+        event.instrument = instrument;
+        event.sequenceNumber = sequenceNumber;
+        event.deliveryTime = deliveryTime;
+        event.askPrices.fill(0);
+        event.askVolumes.fill(0);
+        event.bidPrices.fill(0);
+        event.bidVolumes.fill(0);
+
+        bool buyersAggressing = uniform() < 0.5;
+        long levels = 1 + (long) (uniform() * 2); // trades usually only reach a level or two
+        for (long i = 0; i < levels; i++) {
+            unsigned long volume = 1 + std::geometric_distribution<unsigned long>(1 / config.meanTradeVolume)(rng);
+            if (buyersAggressing) {
+                event.askPrices[i] = book.askPrices[i];
+                event.askVolumes[i] = std::min(volume, book.askVolumes[i]);
+            } else {
+                event.bidPrices[i] = book.bidPrices[i];
+                event.bidVolumes[i] = std::min(volume, book.bidVolumes[i]);
+            }
+        }
+        return event;
+    }
+    double uniform() {
+        return std::uniform_real_distribution<double>(0, 1)(rng);
+    }
+};
+
+#endif //READY_TRADER_GO_2024_MARKET_GENERATOR_H
@@ -7,6 +7,7 @@
 
 #include <array>
 #include "data_handling.h"
+#include "incremental.h"
 
 /* This header is for building estimates of the 'mid-point' or 'fair-value'.
  * New Estimators of a fair value are created by inheriting the AbstractMid class.
@@ -61,14 +62,20 @@ private:
         /* Return it */
         return mid;
     }
+    // the last fair value of each instrument, so an unchanged book needn't be recalculated
+    StageCache<BookKey, std::optional<double>> etfCache, futureCache;
 public:
     InverseVWAP() {}
-    std::optional<long> calculateMid(const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPricesIn,
+    std::optional<long> calculateMid(Instrument instrument,
+                        const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPricesIn,
                         const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumesIn,
                         const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPricesIn,
                         const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumesIn) {
         /* Do an inverse weighted average of average bid and ask prices */
-        std::optional<double> vwapOptional = calculateInverseVWAP(askPricesIn, askVolumesIn, bidPricesIn, bidVolumesIn);
+        StageCache<BookKey, std::optional<double>> &cache = instrument == Instrument::ETF ? etfCache : futureCache;
+        std::optional<double> vwapOptional = cache.getOrCompute(
+                BookKey(askPricesIn, askVolumesIn, bidPricesIn, bidVolumesIn),
+                [&] { return calculateInverseVWAP(askPricesIn, askVolumesIn, bidPricesIn, bidVolumesIn); });
         if (!vwapOptional.has_value()) return {};
 
         double mid = vwapOptional.value();
@@ -79,6 +86,108 @@ public:
     }
 };
 
+class LeadLagEstimator {
+    /* Futures lead the ETF (see granger_causality.ipynb). Once per sequence we take the move in the futures mid and
+     * in the ETF fair value, and keep rolling sums of each ETF move times the futures move k sequences before it,
+     * for k = 0..maxLag, over the last window sequences. Moves are whole cents, so the sums stay exact as old
+     * sequences drop out, and each update costs O(maxLag) whatever the window.
+     * Mid moves average close to zero, so we don't demean them: beta at lag k is sum(etf move * lagged futures move)
+     * / sum(futures move^2). */
+public:
+    static constexpr int maxLag = 8; // sequences
+    static constexpr long window = 240; // a minute of sequences
+    static constexpr long minimumSequences = 40; // before which we don't trust the estimates
+
+    void onSequence(long futureMid, long etfMid) {
+        /* called once per sequence, with both mids for that sequence */
+        if (lastFutureMid == 0) {
+            lastFutureMid = futureMid;
+            lastEtfMid = etfMid;
+            return;
+        }
+        long futureMove = futureMid - lastFutureMid, etfMove = etfMid - lastEtfMid;
+        lastFutureMid = futureMid;
+        lastEtfMid = etfMid;
+
+        // the ETF move leaving the window shares its slot with the one arriving
+        long t = count ++;
+        long leavingEtfMove = etfMoves[t % window];
+        etfMoves[t % window] = etfMove;
+        futureMoves[t % futureHistory] = futureMove;
+
+        futureSquares += futureMove * futureMove;
+        if (t >= window) futureSquares -= getFutureMove(t - window) * getFutureMove(t - window);
+        for (int k = 0; k <= maxLag; k++) {
+            if (t - k >= 0) crossSums[k] += etfMove * getFutureMove(t - k);
+            if (t - window - k >= 0) crossSums[k] -= leavingEtfMove * getFutureMove(t - window - k);
+        }
+    }
+    double getBeta(int lag) const {
+        /* how much of a futures move the ETF makes lag sequences later */
+        if ((count < minimumSequences) || (futureSquares == 0)) return 0;
+        return (double) crossSums[lag] / (double) futureSquares;
+    }
+    int getLag() const {
+        /* the lag at which the ETF follows the futures most strongly */
+        int best = 0;
+        for (int k = 1; k <= maxLag; k++)
+            if (std::abs(crossSums[k]) > std::abs(crossSums[best])) best = k;
+        return best;
+    }
+    double getBeta() const {
+        return getBeta(getLag());
+    }
+    double getProjection() const {
+        /* The ETF move still to come from the futures moves we've seen. A futures move j sequences ago has already
+         * shown up in the ETF at lags 0..j, so what's left of it is the sum of the betas beyond j */
+        if (count < minimumSequences) return 0;
+        double projection = 0, remainingBeta = 0;
+        for (int j = maxLag - 1; j >= 0; j--) {
+            remainingBeta += getBeta(j + 1);
+            if (count - 1 - j >= 0) projection += remainingBeta * getFutureMove(count - 1 - j);
+        }
+        return projection;
+    }
+    void save(CheckpointWriter &writer) const {
+        writer.write(lastFutureMid);
+        writer.write(lastEtfMid);
+        writer.write(count);
+        writer.write(futureMoves);
+        writer.write(etfMoves);
+        writer.write(crossSums);
+        writer.write(futureSquares);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(lastFutureMid);
+        reader.read(lastEtfMid);
+        reader.read(count);
+        reader.read(futureMoves);
+        reader.read(etfMoves);
+        reader.read(crossSums);
+        reader.read(futureSquares);
+    }
+    void print() const {
+        std::cout << "------=+ Futures to ETF lead-lag +=------" << std::endl
+                  << "    - Strongest lag = " << getLag() << " sequences, beta = " << getBeta() << std::endl
+                  << "    - Beta by lag =";
+        for (int k = 0; k <= maxLag; k++) std::cout << " " << getBeta(k);
+        std::cout << std::endl << std::endl;
+    }
+private:
+    static constexpr long futureHistory = window + maxLag + 1; // futures moves we need, from the oldest pair in the window
+
+    long lastFutureMid = 0, lastEtfMid = 0;
+    long count = 0; // moves seen
+    std::array<long, futureHistory> futureMoves = {};
+    std::array<long, window> etfMoves = {};
+    std::array<long long, maxLag + 1> crossSums = {};
+    long long futureSquares = 0;
+
+    long getFutureMove(long t) const {
+        return futureMoves[t % futureHistory];
+    }
+};
+
 class MidMetrics {
     /* Calculates the 'mid-metric' for a set of estimations of mid-value. */
 private:
@@ -102,16 +211,17 @@ public:
         if (instrument != Instrument::ETF) { return; }
 
         /* For each estimate */
+        bool scored = false;
         for (auto pair: midEstimations) {
             std::string name = pair.first;
             MarketStream* stream = pair.second;
 
             std::optional<float> prevMid = stream->getBack();
             if (!prevMid.has_value()) continue;
+            scored = true;
 
             /* Sum the absolute distance from the mid where trades took place */
             for (int i = 0; i < TOP_LEVEL_COUNT; i ++) {
-                    totalTrades += askVolumes[i] + bidVolumes[i];
                     if (askPrices[i] != 0) {
                         long ticksFromMid = std::abs(askPrices[i] - prevMid.value());
                         currScores[name] += ticksFromMid * askVolumes[i];
@@ -123,6 +233,28 @@ public:
                     }
                 }
         }
+
+        /* The trades are counted once, however many estimates scored them */
+        if (scored)
+            for (int i = 0; i < TOP_LEVEL_COUNT; i ++) totalTrades += askVolumes[i] + bidVolumes[i];
+    }
+    void save(CheckpointWriter &writer) const {
+        writer.write(currScores);
+        writer.write(totalTrades);
+    }
+    void load(CheckpointReader &reader) {
+        // the estimation streams are bound in code, so we only restore the scores
+        reader.read(currScores);
+        reader.read(totalTrades);
+    }
+    long long getTotalTrades() const {
+        return totalTrades;
+    }
+    double getScore(const std::string &name) const {
+        /* returns the average distance of trades from the named estimate */
+        auto score = currScores.find(name);
+        if ((score == currScores.end()) || (totalTrades == 0)) return 0;
+        return (double) score->second / (double) totalTrades;
     }
     void printMetrics() {
         std::cout << "Fair value score: " << std::endl;
@@ -29,6 +29,12 @@ public:
     unsigned long getCurrent() const {
         return currClientOrderID;
     }
+    void save(CheckpointWriter &writer) const {
+        writer.write(currClientOrderID);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(currClientOrderID);
+    }
 };
 
 /* Books store an individual order book internally. One can have many books if they would like.
@@ -140,7 +146,7 @@ public:
         return newOrder;
     }
     void cancelOrder(unsigned long clientOrderID) {
-        /* called when we cancel an order */
+        /* called when we cancel an order. It stays in the book until the exchange closes it */
 
         std::optional<Order> orderOptional = findOrder(clientOrderID);
         if (!orderOptional.has_value()) {
@@ -148,10 +154,35 @@ public:
         } else {
             ordersCancelled ++;
         }
+        (orderOptional->side == Side::BUY ? bids : asks)[clientOrderID].cancelling = true;
     }
 
     /* Tracking for metrics */
     long ordersSent = 0, lotsFilled = 0, ordersCancelled = 0;
+
+    /* checkpointing */
+    void save(CheckpointWriter &writer) const {
+        writer.write(exposure);
+        writer.write(submittedBids);
+        writer.write(submittedAsks);
+        writer.write(dummyCash);
+        writer.write(bids);
+        writer.write(asks);
+        writer.write(ordersSent);
+        writer.write(lotsFilled);
+        writer.write(ordersCancelled);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(exposure);
+        reader.read(submittedBids);
+        reader.read(submittedAsks);
+        reader.read(dummyCash);
+        reader.read(bids);
+        reader.read(asks);
+        reader.read(ordersSent);
+        reader.read(lotsFilled);
+        reader.read(ordersCancelled);
+    }
 };
 
 /* There will be two instances of this class instantiated, a Futures Book Container, and an ETF Book Container.
@@ -170,6 +201,8 @@ private:
     long submittedAsks = 0;
     long exposure = 0;
     double dummyCash = 0;
+    unsigned long version = 0; // bumped whenever our orders or position change
+    long lotsFilled = 0, ordersSent = 0, ordersCancelled = 0; // totals across books, for metrics
 public:
     BooksContainer(std::vector<std::string> namesIn, Instrument inst, Logger *loggerIn, Time *timeIn, OrderIDGenerator *idGen, TradeMatcher *matcherIn):
     instrument(inst), logger(loggerIn), time(timeIn), idGenerator(idGen), matchingEngine(matcherIn) {
@@ -177,15 +210,22 @@ public:
             books[name] = Book(instrument, logger, time, idGenerator);
     };
 
+    void addBook(const std::string &name) {
+        if (books.count(name) == 0) books[name] = Book(instrument, logger, time, idGenerator);
+    }
+
     /* setters */
     void sendOrder(std::string name, Instrument instrument, Side side, long size, long price) {
         if (books.count(name) == 0) return;
+        version ++;
+        ordersSent ++;
         books[name].sendOrder(instrument, side, size, price);
         if (side == Side::BUY) submittedBids += size;
         else if (side == Side::SELL) submittedAsks += size;
     }
     void cancelOrder(unsigned long clientOrderID) {
         for (auto &pair: books) {
+            if (pair.second.findOrder(clientOrderID).has_value()) ordersCancelled ++;
             pair.second.cancelOrder(clientOrderID);
         }
     }
@@ -193,7 +233,9 @@ public:
         for (auto &pair: books) {
             std::optional<Order> orderOptional = pair.second.orderFilled(clientOrderID, price, fillVolume);
             if (orderOptional.has_value()) {
+                version ++;
                 Order order = orderOptional.value();
+                lotsFilled += order.size;
                 if (Side::BUY == order.side) {
                     exposure += order.size;
                     submittedBids -= order.size;
@@ -213,6 +255,7 @@ public:
         for (auto &pair: books) {
             std::optional<Order> orderOptional = pair.second.orderClosed(clientOrderID);
             if (orderOptional.has_value()) {
+                version ++;
                 Order order = orderOptional.value();
                 if (Side::BUY == order.side) submittedBids -= order.size;
                 else if (Side::SELL == order.side) submittedAsks -= order.size;
@@ -233,6 +276,23 @@ public:
     double getDummyCash() {
         return dummyCash;
     }
+    unsigned long getVersion() {
+        return version;
+    }
+    long getLotsFilled() {
+        return lotsFilled;
+    }
+    long getOrdersSent() {
+        return ordersSent;
+    }
+    long getOrdersCancelled() {
+        return ordersCancelled;
+    }
+    long getLiveOrders() {
+        long liveOrders = 0;
+        for (auto &pair: books) liveOrders += pair.second.bids.size() + pair.second.asks.size();
+        return liveOrders;
+    }
     OrderList getBids() {
         OrderList bids;
         for (auto &pair: books) {
@@ -258,9 +318,49 @@ public:
         if (books.count(name) == 0) return {};
         return books[name];
     }
+    const Book *findBook(const std::string &name) const {
+        /* unlike getBook, doesn't copy the book. The pointer stays valid for the life of the container */
+        auto book = books.find(name);
+        return book == books.end() ? nullptr : &book->second;
+    }
     std::map<std::string, Book> getBooks() {
         return books;
     };
+
+    /* checkpointing */
+    void save(CheckpointWriter &writer) const {
+        writer.write((std::uint64_t) books.size());
+        for (auto &pair: books) {
+            writer.write(pair.first);
+            pair.second.save(writer);
+        }
+        writer.write(submittedBids);
+        writer.write(submittedAsks);
+        writer.write(exposure);
+        writer.write(dummyCash);
+        writer.write(version);
+        writer.write(lotsFilled);
+        writer.write(ordersSent);
+        writer.write(ordersCancelled);
+    }
+    void load(CheckpointReader &reader) {
+        // we only restore books we already have, as the names are fixed when we're constructed
+        std::uint64_t bookCount = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; (i < bookCount) && reader.isOk(); i ++) {
+            std::string name = reader.read<std::string>();
+            Book discarded;
+            Book &book = books.count(name) != 0 ? books[name] : discarded;
+            book.load(reader);
+        }
+        reader.read(submittedBids);
+        reader.read(submittedAsks);
+        reader.read(exposure);
+        reader.read(dummyCash);
+        reader.read(version);
+        reader.read(lotsFilled);
+        reader.read(ordersSent);
+        reader.read(ordersCancelled);
+    }
 };
 
 #endif //CPPREADY_TRADER_GO_ORDER_BOOK_H
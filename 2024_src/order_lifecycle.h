@@ -0,0 +1,213 @@
+#ifndef READY_TRADER_GO_2024_ORDER_LIFECYCLE_H
+#define READY_TRADER_GO_2024_ORDER_LIFECYCLE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <ready_trader_go/types.h>
+#include "telemetry.h"
+
+/* Follows each order from send to close, so we can see what our quoting actually buys us.
+ *
+ * Every order is stamped at send, ack (its first status message), first fill, cancel and close, using the event
+ * time of the callback. Send-to-fill and cancel-to-close latencies go into histograms broken down by side, and by how
+ * far from the mid we quoted. For resting ETF orders we also estimate how many lots are queued ahead of us at our
+ * price: we join the back of the displayed level, trades at our price eat the queue ahead of us, and the queue ahead
+ * can never be more than the level's displayed volume less our own. */
+
+struct OrderTimeline {
+    ReadyTraderGo::Instrument instrument;
+    ReadyTraderGo::Side side;
+    long price, remaining;
+    int distanceBucket;
+    std::int64_t sendTime, ackTime = 0, fillTime = 0, cancelTime = 0; // 0 if it hasn't happened
+    long queueAhead = 0, queueAheadAtSend = 0; // estimated lots ahead of us at our price
+};
+
+class OrderLifecycleTracker {
+public:
+    // distances from the mid (one-sided, in cents) at which the buckets start
+    static constexpr int distanceBucketCount = 5;
+    static constexpr std::array<long, distanceBucketCount> distanceBuckets = {0, 100, 200, 300, 500};
+
+    OrderLifecycleTracker() {
+        orders.reserve(1024);
+    }
+
+    void orderSent(unsigned long clientOrderID, ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side,
+                   long price, long volume, long mid, std::int64_t eventTime) {
+        OrderTimeline timeline;
+        timeline.instrument = instrument;
+        timeline.side = side;
+        timeline.price = price;
+        timeline.remaining = volume;
+        timeline.distanceBucket = getDistanceBucket(side == ReadyTraderGo::Side::BUY ? mid - price : price - mid);
+        timeline.sendTime = eventTime;
+        if (instrument == ReadyTraderGo::Instrument::ETF) {
+            // we join the back of the level
+            timeline.queueAhead = timeline.queueAheadAtSend = std::max(0L, getDisplayedVolume(side, price));
+            SideStats &stats = getStats(timeline);
+            stats.ordersSent ++;
+            stats.totalQueueAheadAtSend += timeline.queueAheadAtSend;
+        }
+        orders[clientOrderID] = timeline;
+    }
+    void cancelSent(unsigned long clientOrderID, std::int64_t eventTime) {
+        auto order = orders.find(clientOrderID);
+        if ((order != orders.end()) && (order->second.cancelTime == 0)) order->second.cancelTime = eventTime;
+    }
+    void statusReceived(unsigned long clientOrderID, std::int64_t eventTime) {
+        auto order = orders.find(clientOrderID);
+        if ((order == orders.end()) || (order->second.ackTime != 0)) return;
+        order->second.ackTime = eventTime;
+        getLatencies(order->second).sendToAck.record(eventTime - order->second.sendTime);
+    }
+    void filled(unsigned long clientOrderID, long volume, std::int64_t eventTime) {
+        auto order = orders.find(clientOrderID);
+        if (order == orders.end()) return;
+        OrderTimeline &timeline = order->second;
+        timeline.remaining -= volume;
+        if (timeline.fillTime == 0) {
+            timeline.fillTime = eventTime;
+            getLatencies(timeline).sendToFill.record(eventTime - timeline.sendTime);
+            if (timeline.instrument == ReadyTraderGo::Instrument::ETF) {
+                SideStats &stats = getStats(timeline);
+                stats.ordersFilled ++;
+                stats.totalQueueAheadAtFill += timeline.queueAhead;
+            }
+        }
+        if ((timeline.instrument == ReadyTraderGo::Instrument::ETF) && (timeline.remaining > 0)) return;
+
+        /* A full fill closes the order, and hedges are fill and kill, so get one fill and nothing after. We stop
+         * tracking it now, so an order filled before its first status is acked here */
+        if ((timeline.instrument == ReadyTraderGo::Instrument::ETF) && (timeline.ackTime == 0))
+            statusReceived(clientOrderID, eventTime);
+        retire(order, eventTime);
+    }
+    void closed(unsigned long clientOrderID, std::int64_t eventTime) {
+        auto order = orders.find(clientOrderID);
+        if (order != orders.end()) retire(order, eventTime);
+    }
+
+    void onOrderBook(const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+        /* called on every ETF book. Lots that leave the level must have come from ahead of us if there are now fewer
+         * lots than we thought were ahead */
+        lastAskPrices = askPrices;
+        lastAskVolumes = askVolumes;
+        lastBidPrices = bidPrices;
+        lastBidVolumes = bidVolumes;
+
+        // our own volume at each level shown, bids then asks, summed once for every order to use
+        std::array<std::array<long, ReadyTraderGo::TOP_LEVEL_COUNT>, 2> ownVolumes = {};
+        for (auto &pair: orders) {
+            const OrderTimeline &timeline = pair.second;
+            if (timeline.instrument != ReadyTraderGo::Instrument::ETF) continue;
+            int level = getLevel(timeline.side, timeline.price);
+            if (level >= 0) ownVolumes[timeline.side == ReadyTraderGo::Side::BUY ? 0 : 1][level] += timeline.remaining;
+        }
+
+        for (auto &pair: orders) {
+            OrderTimeline &timeline = pair.second;
+            if (timeline.instrument != ReadyTraderGo::Instrument::ETF) continue;
+
+            int level = getLevel(timeline.side, timeline.price);
+            if (level < 0) continue; // our level is outside the top of the book, so we can't see it
+
+            bool isBid = timeline.side == ReadyTraderGo::Side::BUY;
+            long others = (long) (isBid ? bidVolumes : askVolumes)[level] - ownVolumes[isBid ? 0 : 1][level];
+            timeline.queueAhead = std::min(timeline.queueAhead, std::max(0L, others));
+        }
+    }
+    void onTradeTicks(const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+        /* called on every ETF trade tick. Trades at our price fill the front of the queue first */
+        for (auto &pair: orders) {
+            OrderTimeline &timeline = pair.second;
+            if (timeline.instrument != ReadyTraderGo::Instrument::ETF) continue;
+
+            bool isBid = timeline.side == ReadyTraderGo::Side::BUY;
+            const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &prices = isBid ? bidPrices : askPrices;
+            const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &volumes = isBid ? bidVolumes : askVolumes;
+            for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++)
+                if ((long) prices[i] == timeline.price)
+                    timeline.queueAhead = std::max(0L, timeline.queueAhead - (long) volumes[i]);
+        }
+    }
+
+    void print() const {
+        std::cout << "------=+ Order lifecycle +=------" << std::endl;
+        for (int side = 0; side < 2; side++) {
+            for (int bucket = 0; bucket < distanceBucketCount; bucket++) {
+                const Latencies &latencies = etfLatencies[side][bucket];
+                const SideStats &stats = etfStats[side][bucket];
+                if (stats.ordersSent == 0) continue;
+                std::cout << "    - ETF " << (side == 0 ? "bids" : "asks") << " " << distanceBuckets[bucket] << "+ from mid: "
+                          << stats.ordersSent << " sent, " << 100 * stats.ordersFilled / stats.ordersSent << "% filled"
+                          << ", avg queue ahead at send = " << (double) stats.totalQueueAheadAtSend / stats.ordersSent
+                          << ", at first fill = " << (stats.ordersFilled == 0 ? 0 : (double) stats.totalQueueAheadAtFill / stats.ordersFilled)
+                          << std::endl
+                          << "        send to ack p50 = " << latencies.sendToAck.percentile(0.5) << "ns"
+                          << ", send to fill p50/p90 = " << latencies.sendToFill.percentile(0.5) << "/" << latencies.sendToFill.percentile(0.9) << "ns"
+                          << ", cancel to close p50/p90 = " << latencies.cancelToClose.percentile(0.5) << "/" << latencies.cancelToClose.percentile(0.9) << "ns"
+                          << std::endl;
+            }
+        }
+        std::cout << "    - Hedges: send to fill p50/p90 = " << hedgeLatencies.sendToFill.percentile(0.5) << "/"
+                  << hedgeLatencies.sendToFill.percentile(0.9) << "ns" << std::endl << std::endl;
+    }
+private:
+    struct Latencies {
+        LatencyHistogram sendToAck, sendToFill, cancelToClose;
+    };
+    struct SideStats {
+        long ordersSent = 0, ordersFilled = 0;
+        long totalQueueAheadAtSend = 0, totalQueueAheadAtFill = 0;
+    };
+
+    std::unordered_map<unsigned long, OrderTimeline> orders; // live orders only, erased once closed or fully filled
+    Latencies etfLatencies[2][distanceBucketCount], hedgeLatencies;
+    SideStats etfStats[2][distanceBucketCount];
+    std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> lastAskPrices = {}, lastAskVolumes = {},
+                                                              lastBidPrices = {}, lastBidVolumes = {};
+
+    void retire(std::unordered_map<unsigned long, OrderTimeline>::iterator order, std::int64_t eventTime) {
+        if (order->second.cancelTime != 0)
+            getLatencies(order->second).cancelToClose.record(eventTime - order->second.cancelTime);
+        orders.erase(order);
+    }
+    static int getDistanceBucket(long distance) {
+        int bucket = 0;
+        while ((bucket + 1 < distanceBucketCount) && (distance >= distanceBuckets[bucket + 1])) bucket++;
+        return bucket;
+    }
+    Latencies &getLatencies(const OrderTimeline &timeline) {
+        if (timeline.instrument != ReadyTraderGo::Instrument::ETF) return hedgeLatencies;
+        return etfLatencies[timeline.side == ReadyTraderGo::Side::BUY ? 0 : 1][timeline.distanceBucket];
+    }
+    SideStats &getStats(const OrderTimeline &timeline) {
+        return etfStats[timeline.side == ReadyTraderGo::Side::BUY ? 0 : 1][timeline.distanceBucket];
+    }
+    int getLevel(ReadyTraderGo::Side side, long price) const {
+        /* where a price was among the levels of the last ETF book, or -1 if it wasn't shown */
+        const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &prices =
+                side == ReadyTraderGo::Side::BUY ? lastBidPrices : lastAskPrices;
+        for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++)
+            if ((long) prices[i] == price) return i;
+        return -1;
+    }
+    long getDisplayedVolume(ReadyTraderGo::Side side, long price) const {
+        /* the volume shown at a price in the last ETF book, or -1 if the price wasn't one of the levels shown */
+        int level = getLevel(side, price);
+        if (level < 0) return -1;
+        return (long) (side == ReadyTraderGo::Side::BUY ? lastBidVolumes : lastAskVolumes)[level];
+    }
+};
+
+#endif //READY_TRADER_GO_2024_ORDER_LIFECYCLE_H
@@ -0,0 +1,62 @@
+#ifndef READY_TRADER_GO_2024_OUTBOUND_BATCH_H
+#define READY_TRADER_GO_2024_OUTBOUND_BATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include <ready_trader_go/types.h>
+#include "journal.h"
+
+/* The messages we decide to send while handling one exchange message, held until the handler is done and then sent
+ * back to back. Cancels go first, so the exchange pulls our stale orders before it sees the new ones, and a tick's
+ * messages reach it as one burst rather than spread across the handler. */
+
+struct OutboundMessage {
+    JournalEvent type; // InsertOrder, HedgeOrder or CancelOrder
+    unsigned long clientOrderID;
+    ReadyTraderGo::Side side;
+    unsigned long price, size;
+};
+
+class OutboundBatch {
+public:
+    void reserve(std::size_t messages) {
+        /* so staging a busy tick doesn't allocate */
+        cancels.reserve(messages);
+        orders.reserve(messages);
+    }
+    void stage(const OutboundMessage &message) {
+        if (message.type == JournalEvent::CancelOrder) cancels.push_back(message);
+        else orders.push_back(message);
+    }
+    bool empty() const {
+        return cancels.empty() && orders.empty();
+    }
+
+    template <typename Send>
+    void flush(Send send) {
+        /* sends every staged message, cancels first, each in the order it was staged */
+        if (empty()) return;
+        std::size_t size = cancels.size() + orders.size();
+        batches ++;
+        messages += size;
+        largestBatch = std::max(largestBatch, size);
+        for (const OutboundMessage &message: cancels) send(message);
+        for (const OutboundMessage &message: orders) send(message);
+        cancels.clear();
+        orders.clear();
+    }
+
+    void print() const {
+        std::cout << "------=+ Outbound batches +=------" << std::endl;
+        std::cout << "    - " << messages << " messages in " << batches << " batches, at most " << largestBatch << " at once" << std::endl;
+        std::cout << std::endl;
+    }
+private:
+    std::vector<OutboundMessage> cancels, orders;
+    unsigned long batches = 0, messages = 0;
+    std::size_t largestBatch = 0;
+};
+
+#endif //READY_TRADER_GO_2024_OUTBOUND_BATCH_H
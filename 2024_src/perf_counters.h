@@ -0,0 +1,148 @@
+#ifndef READY_TRADER_GO_2024_PERF_COUNTERS_H
+#define READY_TRADER_GO_2024_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Hardware counters around the trading handlers, so we can see why a handler is slow rather than just that it is.
+ *
+ * Counters are read with perf_event_open as one group, so a handler costs two read() calls when profiling is on, and
+ * a single branch when it's off. Only user space is counted, which is allowed at the default perf_event_paranoid.
+ * If the counters can't be opened (e.g. in a VM without a PMU) we carry on without them. */
+
+enum class ProfiledHandler : int {
+    OrderBook, TradeTicks, MakeMarket, OrderFilled, HedgeFilled, OrderStatus, Count
+};
+
+class HandlerProfiler {
+public:
+    static constexpr int counterCount = 5;
+
+    HandlerProfiler(bool useProfilingIn) {
+        if (!useProfilingIn) return;
+
+        const std::array<std::pair<std::uint32_t, std::uint64_t>, counterCount> events = {{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+        }};
+        for (int i = 0; i < counterCount; i++) {
+            fds[i] = openCounter(events[i].first, events[i].second, i == 0 ? -1 : fds[0]);
+            if (fds[i] < 0) {
+                std::cerr << "couldn't open performance counters, handlers won't be profiled" << std::endl;
+                closeCounters();
+                return;
+            }
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        enabled = true;
+    }
+    ~HandlerProfiler() {
+        closeCounters();
+    }
+    HandlerProfiler(const HandlerProfiler&) = delete;
+    HandlerProfiler &operator=(const HandlerProfiler&) = delete;
+
+    bool isEnabled() const {
+        return enabled;
+    }
+    bool read(std::array<std::uint64_t, counterCount> &values) const {
+        /* reads every counter in the group at once */
+        struct { std::uint64_t count; std::uint64_t values[counterCount]; } group;
+        if (::read(fds[0], &group, sizeof(group)) != (ssize_t) sizeof(group)) return false;
+        std::memcpy(values.data(), group.values, sizeof(group.values));
+        return true;
+    }
+    void record(ProfiledHandler handler, const std::array<std::uint64_t, counterCount> &start,
+                const std::array<std::uint64_t, counterCount> &end) {
+        HandlerTotals &totals = handlers[(int) handler];
+        totals.calls ++;
+        for (int i = 0; i < counterCount; i++) totals.counters[i] += end[i] - start[i];
+    }
+
+    void print() const {
+        if (!enabled) return;
+        static const char *handlerNames[] = {"OrderBook", "TradeTicks", "makeMarket", "OrderFilled", "HedgeFilled", "OrderStatus"};
+
+        std::ios_base::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        std::cout << "------=+ Handler performance counters (per call) +=------" << std::endl;
+        for (int h = 0; h < (int) ProfiledHandler::Count; h++) {
+            const HandlerTotals &totals = handlers[h];
+            if (totals.calls == 0) continue;
+            double calls = totals.calls;
+            double ipc = totals.counters[0] == 0 ? 0 : (double) totals.counters[1] / totals.counters[0];
+            std::cout << "    - " << std::left << std::setw(12) << handlerNames[h] << std::right << std::fixed << std::setprecision(2)
+                      << " calls = " << totals.calls
+                      << ", cycles = " << totals.counters[0] / calls
+                      << ", instructions = " << totals.counters[1] / calls
+                      << ", IPC = " << ipc
+                      << ", cache misses = " << totals.counters[2] / calls
+                      << ", branch misses = " << totals.counters[3] / calls
+                      << ", context switches = " << totals.counters[4] / calls << std::endl;
+        }
+        std::cout << std::endl;
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+private:
+    struct HandlerTotals {
+        std::uint64_t calls = 0;
+        std::array<std::uint64_t, counterCount> counters = {};
+    };
+
+    std::array<int, counterCount> fds = {-1, -1, -1, -1, -1};
+    bool enabled = false;
+    HandlerTotals handlers[(int) ProfiledHandler::Count];
+
+    static int openCounter(std::uint32_t type, std::uint64_t config, int groupFd) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = groupFd == -1; // the group starts when its leader is enabled
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return (int) syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+    void closeCounters() {
+        for (int &fd: fds) {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+        enabled = false;
+    }
+};
+
+class ProfileScope {
+    /* Counts everything between construction and destruction against a handler */
+public:
+    ProfileScope(HandlerProfiler &profilerIn, ProfiledHandler handlerIn): profiler(profilerIn), handler(handlerIn) {
+        active = profiler.isEnabled() && profiler.read(start);
+    }
+    ~ProfileScope() {
+        std::array<std::uint64_t, HandlerProfiler::counterCount> end;
+        if (active && profiler.read(end)) profiler.record(handler, start, end);
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope &operator=(const ProfileScope&) = delete;
+private:
+    HandlerProfiler &profiler;
+    ProfiledHandler handler;
+    std::array<std::uint64_t, HandlerProfiler::counterCount> start;
+    bool active;
+};
+
+#endif //READY_TRADER_GO_2024_PERF_COUNTERS_H
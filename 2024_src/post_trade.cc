@@ -0,0 +1,353 @@
+//
+// Does the dashboard's preprocessing ahead of time, so a long session loads in seconds rather than minutes.
+// Usage: post_trade [log directory] [threads]
+// e.g. post_trade custom_log 8. Reads the Logger's csvs from the directory, and writes alongside them:
+//     order_book_etf.csv  - the ETF book's leading and trailing prices on each side
+//     trade_ticks_etf.csv - the ETF trade ticks' total volume and volume weighted price on each side
+//     trades_pnl.csv      - every fill, with our positions, cash and marked to market profit after it
+//     session_summary.csv - orders, fills and profit per instrument
+// The books and ticks are split into chunks which are parsed on separate threads, while the fills are joined against
+// the mids on another. The dashboard loads these tables in place of its own when they're there.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+static bool readFile(const std::string &path, std::string &contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+static void writeFile(const std::string &path, const std::string &header, const std::vector<std::string> &chunks) {
+    std::ofstream file(path, std::ios::binary);
+    file << header << "\n";
+    for (const std::string &chunk: chunks) file << chunk;
+}
+
+static void splitLine(std::string_view line, std::vector<std::string_view> &fields) {
+    fields.clear();
+    std::size_t start = 0;
+    while (true) {
+        std::size_t comma = line.find(',', start);
+        if (comma == std::string_view::npos) {
+            fields.push_back(line.substr(start));
+            return;
+        }
+        fields.push_back(line.substr(start, comma - start));
+        start = comma + 1;
+    }
+}
+
+static unsigned long toUnsigned(std::string_view field) {
+    unsigned long value = 0;
+    std::from_chars(field.data(), field.data() + field.size(), value);
+    return value;
+}
+
+static double toDouble(std::string_view field) {
+    /* the Logger writes doubles with the default stream format, so we may see e.g. 1e+06 */
+    return std::strtod(std::string(field).c_str(), nullptr);
+}
+
+enum class LoggedInstrument {
+    Future, ETF, Unknown
+};
+
+static LoggedInstrument toInstrument(std::string_view field) {
+    /* prices.csv has the instrument as a number, the others as a name */
+    if ((field == "ETF") || (field == "1")) return LoggedInstrument::ETF;
+    if ((field == "Future") || (field == "FUTURE") || (field == "0")) return LoggedInstrument::Future;
+    return LoggedInstrument::Unknown;
+}
+
+class CsvFile {
+    /* A Logger csv held in memory, with its header parsed */
+public:
+    bool open(const std::string &path) {
+        if (!readFile(path, contents)) return false;
+        std::size_t headerEnd = contents.find('\n');
+        if (headerEnd == std::string::npos) headerEnd = contents.size();
+
+        std::vector<std::string_view> names;
+        splitLine(std::string_view(contents).substr(0, headerEnd), names);
+        for (std::size_t i = 0; i < names.size(); i++) columns[std::string(names[i])] = i;
+        bodyStart = std::min(headerEnd + 1, contents.size());
+        return true;
+    }
+    std::size_t column(const std::string &name) const {
+        auto found = columns.find(name);
+        if (found == columns.end()) {
+            std::cerr << "missing column " << name << std::endl;
+            std::exit(1);
+        }
+        return found->second;
+    }
+    std::vector<std::string_view> split(std::size_t chunkCount) const {
+        /* splits the body into roughly equal chunks, on line boundaries */
+        std::vector<std::string_view> chunks;
+        std::string_view body = std::string_view(contents).substr(bodyStart);
+        std::size_t target = body.size() / chunkCount + 1, start = 0;
+        while (start < body.size()) {
+            std::size_t end = std::min(start + target, body.size());
+            end = body.find('\n', end == 0 ? 0 : end - 1);
+            end = end == std::string_view::npos ? body.size() : end + 1;
+            chunks.push_back(body.substr(start, end - start));
+            start = end;
+        }
+        return chunks;
+    }
+    void forEachRow(std::string_view chunk, std::size_t minimumFields,
+                    const std::function<void(const std::vector<std::string_view>&)> &onRow) const {
+        /* rows too short for the columns the caller reads are skipped, e.g. a line cut off when the trader stopped */
+        std::vector<std::string_view> fields;
+        std::size_t start = 0;
+        while (start < chunk.size()) {
+            std::size_t end = chunk.find('\n', start);
+            if (end == std::string_view::npos) end = chunk.size();
+            std::string_view line = chunk.substr(start, end - start);
+            if (!line.empty() && (line.back() == '\r')) line.remove_suffix(1);
+            if (!line.empty()) {
+                splitLine(line, fields);
+                if (fields.size() >= minimumFields) onRow(fields);
+            }
+            start = end + 1;
+        }
+    }
+private:
+    std::string contents;
+    std::size_t bodyStart = 0;
+    std::map<std::string, std::size_t> columns;
+};
+
+struct BookColumns {
+    /* where each level's prices and volumes are */
+    std::size_t time, instrument;
+    std::size_t askPrice[5], askVolume[5], bidPrice[5], bidVolume[5];
+    std::size_t fields = 0; // how many fields a row needs for us to read it
+
+    void read(const CsvFile &file) {
+        time = file.column("time");
+        instrument = file.column("instrument");
+        for (int i = 0; i < 5; i++) {
+            askPrice[i] = file.column("askPrice" + std::to_string(i));
+            askVolume[i] = file.column("askVol" + std::to_string(i));
+            bidPrice[i] = file.column("bidPrice" + std::to_string(i));
+            bidVolume[i] = file.column("bidVol" + std::to_string(i));
+            fields = std::max({fields, askPrice[i] + 1, askVolume[i] + 1, bidPrice[i] + 1, bidVolume[i] + 1});
+        }
+        fields = std::max({fields, time + 1, instrument + 1});
+    }
+};
+
+static void appendOptional(std::string &out, unsigned long value) {
+    /* zero means no price, which we leave empty so pandas reads it as NaN */
+    out += ',';
+    if (value != 0) out += std::to_string(value);
+}
+
+static void processOrderBook(const CsvFile &file, const BookColumns &columns, std::string_view chunk, std::string &out) {
+    /* time, leading_bid, trailing_bid, leading_ask, trailing_ask. The trailing price is the least competitive nonzero one */
+    file.forEachRow(chunk, columns.fields, [&](const std::vector<std::string_view> &fields) {
+        if (toInstrument(fields[columns.instrument]) != LoggedInstrument::ETF) return;
+        unsigned long trailingBid = 0, trailingAsk = 0;
+        for (int i = 4; i >= 0; i--) {
+            if (trailingBid == 0) trailingBid = toUnsigned(fields[columns.bidPrice[i]]);
+            if (trailingAsk == 0) trailingAsk = toUnsigned(fields[columns.askPrice[i]]);
+        }
+        out += fields[columns.time];
+        appendOptional(out, toUnsigned(fields[columns.bidPrice[0]]));
+        appendOptional(out, trailingBid);
+        appendOptional(out, toUnsigned(fields[columns.askPrice[0]]));
+        appendOptional(out, trailingAsk);
+        out += '\n';
+    });
+}
+
+static void processTradeTicks(const CsvFile &file, const BookColumns &columns, std::string_view chunk, std::string &out) {
+    /* time, total_bids, total_asks, average_bid, average_ask. The averages are volume weighted */
+    char buffer[32];
+    auto appendAverage = [&](unsigned long notional, unsigned long volume) {
+        out += ',';
+        if (volume == 0) return;
+        std::snprintf(buffer, sizeof(buffer), "%.2f", (double) notional / volume);
+        out += buffer;
+    };
+    file.forEachRow(chunk, columns.fields, [&](const std::vector<std::string_view> &fields) {
+        if (toInstrument(fields[columns.instrument]) != LoggedInstrument::ETF) return;
+        unsigned long bidVolume = 0, askVolume = 0, bidNotional = 0, askNotional = 0;
+        for (int i = 0; i < 5; i++) {
+            unsigned long bid = toUnsigned(fields[columns.bidVolume[i]]), ask = toUnsigned(fields[columns.askVolume[i]]);
+            bidVolume += bid;
+            askVolume += ask;
+            bidNotional += bid * toUnsigned(fields[columns.bidPrice[i]]);
+            askNotional += ask * toUnsigned(fields[columns.askPrice[i]]);
+        }
+        out += fields[columns.time];
+        out += ',' + std::to_string(bidVolume) + ',' + std::to_string(askVolume);
+        appendAverage(bidNotional, bidVolume);
+        appendAverage(askNotional, askVolume);
+        out += '\n';
+    });
+}
+
+struct InstrumentTotals {
+    unsigned long ordersSent = 0, ordersCancelled = 0, fills = 0, lotsFilled = 0;
+    long position = 0;
+    double cash = 0, lastMid = 0;
+};
+
+static void countOrders(const CsvFile &file, unsigned long InstrumentTotals::*counter, InstrumentTotals totals[2]) {
+    std::size_t instrument = file.column("instrument");
+    for (std::string_view chunk: file.split(1)) {
+        file.forEachRow(chunk, instrument + 1, [&](const std::vector<std::string_view> &fields) {
+            LoggedInstrument logged = toInstrument(fields[instrument]);
+            if (logged != LoggedInstrument::Unknown) totals[(int) logged].*counter += 1;
+        });
+    }
+}
+
+static void joinFills(const CsvFile &fills, const CsvFile &prices, InstrumentTotals totals[2], std::string &out) {
+    /* Walks the fills and the mids together, both being in time order. After each fill we mark our positions to the
+     * latest mids: time, id, instrument, side, volume, price, etf_position, future_position, cash, pnl */
+    std::vector<std::string_view> fillChunks = fills.split(1), priceChunks = prices.split(1);
+    std::vector<std::pair<double, std::pair<LoggedInstrument, double>>> mids;
+    if (!priceChunks.empty()) {
+        std::size_t time = prices.column("time"), instrument = prices.column("instrument"), mid = prices.column("mid");
+        prices.forEachRow(priceChunks[0], std::max({time, instrument, mid}) + 1, [&](const std::vector<std::string_view> &fields) {
+            mids.push_back({toDouble(fields[time]), {toInstrument(fields[instrument]), toDouble(fields[mid])}});
+        });
+    }
+    if (fillChunks.empty()) return;
+
+    std::size_t time = fills.column("time"), id = fills.column("id"), instrument = fills.column("instrument"),
+                side = fills.column("side"), volume = fills.column("volume"), price = fills.column("price");
+    std::size_t nextMid = 0;
+    char buffer[96];
+    fills.forEachRow(fillChunks[0], std::max({time, id, instrument, side, volume, price}) + 1, [&](const std::vector<std::string_view> &fields) {
+        double fillTime = toDouble(fields[time]);
+        while ((nextMid < mids.size()) && (mids[nextMid].first <= fillTime)) {
+            LoggedInstrument logged = mids[nextMid].second.first;
+            if (logged != LoggedInstrument::Unknown) totals[(int) logged].lastMid = mids[nextMid].second.second;
+            nextMid ++;
+        }
+
+        LoggedInstrument logged = toInstrument(fields[instrument]);
+        if (logged == LoggedInstrument::Unknown) return;
+        InstrumentTotals &filled = totals[(int) logged];
+        long lots = (long) toUnsigned(fields[volume]);
+        double notional = (double) lots * toUnsigned(fields[price]);
+        bool buy = fields[side] == "BUY";
+        filled.position += buy ? lots : -lots;
+        filled.cash += buy ? -notional : notional;
+        filled.fills ++;
+        filled.lotsFilled += lots;
+
+        /* a position with no mid yet is marked at its fill price */
+        if (filled.lastMid == 0) filled.lastMid = toUnsigned(fields[price]);
+        InstrumentTotals &etf = totals[(int) LoggedInstrument::ETF], &future = totals[(int) LoggedInstrument::Future];
+        double cash = etf.cash + future.cash;
+        double pnl = cash + etf.position * etf.lastMid + future.position * future.lastMid;
+
+        out += fields[time];
+        for (std::size_t column: {id, instrument, side, volume, price}) {
+            out += ',';
+            out += fields[column];
+        }
+        std::snprintf(buffer, sizeof(buffer), ",%ld,%ld,%.0f,%.0f\n", etf.position, future.position, cash, pnl);
+        out += buffer;
+    });
+
+    /* mark the final positions to the last mids of the session */
+    for (; nextMid < mids.size(); nextMid++) {
+        LoggedInstrument logged = mids[nextMid].second.first;
+        if (logged != LoggedInstrument::Unknown) totals[(int) logged].lastMid = mids[nextMid].second.second;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string directory = argc > 1 ? argv[1] : "custom_log";
+    unsigned int threads = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    CsvFile orderBook, tradeTicks, sent, filled, cancelled, prices;
+    bool hasOrderBook = orderBook.open(directory + "/order_book.csv");
+    bool hasTradeTicks = tradeTicks.open(directory + "/trade_ticks.csv");
+    bool hasFills = filled.open(directory + "/trades_filled.csv");
+    bool hasPrices = prices.open(directory + "/prices.csv");
+    bool hasSent = sent.open(directory + "/trades_sent.csv");
+    bool hasCancelled = cancelled.open(directory + "/trades_cancelled.csv");
+    if (!hasOrderBook && !hasTradeTicks && !hasFills) {
+        std::cerr << "no logs found in " << directory << std::endl;
+        return 1;
+    }
+
+    /* Queue up the work. Each chunk of the books and ticks writes its own output, which we stitch back in order */
+    std::vector<std::function<void()>> tasks;
+    std::vector<std::string_view> bookChunks, tickChunks;
+    std::vector<std::string> bookOut, tickOut, pnlOut(1);
+    BookColumns bookColumns, tickColumns;
+    InstrumentTotals totals[2];
+
+    if (hasOrderBook) {
+        bookChunks = orderBook.split(threads * 4);
+        bookOut.resize(bookChunks.size());
+        bookColumns.read(orderBook);
+        for (std::size_t i = 0; i < bookChunks.size(); i++)
+            tasks.push_back([&, i]() { processOrderBook(orderBook, bookColumns, bookChunks[i], bookOut[i]); });
+    }
+    if (hasTradeTicks) {
+        tickChunks = tradeTicks.split(threads * 4);
+        tickOut.resize(tickChunks.size());
+        tickColumns.read(tradeTicks);
+        for (std::size_t i = 0; i < tickChunks.size(); i++)
+            tasks.push_back([&, i]() { processTradeTicks(tradeTicks, tickColumns, tickChunks[i], tickOut[i]); });
+    }
+    if (hasFills && hasPrices) tasks.push_back([&]() { joinFills(filled, prices, totals, pnlOut[0]); });
+
+    /* the order counts go into their own totals, as the join is writing the others */
+    InstrumentTotals sentTotals[2], cancelledTotals[2];
+    if (hasSent) tasks.push_back([&]() { countOrders(sent, &InstrumentTotals::ordersSent, sentTotals); });
+    if (hasCancelled) tasks.push_back([&]() { countOrders(cancelled, &InstrumentTotals::ordersCancelled, cancelledTotals); });
+
+    std::atomic<std::size_t> nextTask{0};
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < std::min<std::size_t>(threads, tasks.size()); i++) {
+        workers.emplace_back([&]() {
+            for (std::size_t task = nextTask++; task < tasks.size(); task = nextTask++) tasks[task]();
+        });
+    }
+    for (std::thread &worker: workers) worker.join();
+
+    /* Write it all out */
+    if (hasOrderBook) writeFile(directory + "/order_book_etf.csv", "time,leading_bid,trailing_bid,leading_ask,trailing_ask", bookOut);
+    if (hasTradeTicks) writeFile(directory + "/trade_ticks_etf.csv", "time,total_bids,total_asks,average_bid,average_ask", tickOut);
+    if (hasFills && hasPrices)
+        writeFile(directory + "/trades_pnl.csv", "time,id,instrument,side,volume,price,etf_position,future_position,cash,pnl", pnlOut);
+
+    std::ostringstream summary;
+    static const char *instrumentNames[] = {"Future", "ETF"};
+    for (int i = 0; i < 2; i++) {
+        InstrumentTotals &total = totals[i];
+        double pnl = total.cash + total.position * total.lastMid;
+        summary << instrumentNames[i] << "," << sentTotals[i].ordersSent << "," << cancelledTotals[i].ordersCancelled << ","
+                << total.fills << "," << total.lotsFilled << "," << total.position << "," << (long) pnl << "\n";
+    }
+    writeFile(directory + "/session_summary.csv", "instrument,orders_sent,orders_cancelled,fills,lots_filled,position,pnl", {summary.str()});
+
+    std::cout << "wrote the dashboard tables to " << directory << " on " << workers.size() << " thread(s)" << std::endl;
+    return 0;
+}
@@ -5,33 +5,82 @@
 #ifndef READY_TRADER_GO_2024_RATE_LIMITER_H
 #define READY_TRADER_GO_2024_RATE_LIMITER_H
 
-#include <chrono>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "checkpoint.h"
+#include "journal.h"
 
-/* Used to limit the frequency of messages sent to the exchange */
+/* Used to limit the frequency of messages sent to the exchange.
+ * The times of the messages in the last second are kept in a fixed ring inside the limiter, so checking a message
+ * touches no heap memory */
 class MessageFrequencyLimiter {
 public:
-    bool sendMessage() {
-        // returns true if a message can be sent, else false
-        double time = (std::chrono::system_clock::now() - startTime).count();
-        while ( (messageTimes.size() > 0) &&
-                (time - messageTimes.front() > 1) )
-            messageTimes.pop_front();
+    static constexpr std::size_t maxMessagesPerSecond = 500; // at the fastest speed, see setSpeed
 
-        if (messageTimes.size() < messagesPerSecond) {
-            messageTimes.push_back(time);
+    bool sendMessage(std::int64_t eventTime) {
+        // returns true if a message can be sent at the given time, else false.
+        // the time is passed in (rather than read from the clock) so a replayed session limits exactly as it did live.
+        // it's a journal timestamp, in nanoseconds
+        if (startTime == 0) startTime = eventTime;
+        std::int64_t time = eventTime - startTime;
+        while ( (count > 0) &&
+                (time - messageTimes[oldest] >= journalTicksPerSecond) ) {
+            oldest = (oldest + 1) % maxMessagesPerSecond;
+            count --;
+        }
+
+        if (count < messagesPerSecond) {
+            messageTimes[(oldest + count) % maxMessagesPerSecond] = time;
+            count ++;
             return true;
         } else {
+            refusals ++;
             return false;
         }
     }
     void setSpeed(int speed) {
-        messagesPerSecond = speed * 50;
+        messagesPerSecond = std::min<std::size_t>(speed * 50, maxMessagesPerSecond);
+    }
+    long getHeadroom() const {
+        // returns how many more messages we could send right now, as of the last message we sent
+        return (long) messagesPerSecond - (long) count;
+    }
+    double getUtilisation() const {
+        // returns the fraction of our per-second budget used by recent messages
+        return (double) count / messagesPerSecond;
+    }
+    void save(CheckpointWriter &writer) const {
+        writer.write(startTime);
+        writer.write(messageTimes);
+        writer.write(oldest);
+        writer.write(count);
+        writer.write(refusals);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(startTime);
+        reader.read(messageTimes);
+        reader.read(oldest);
+        reader.read(count);
+        reader.read(refusals);
+    }
+    unsigned long getRefusals() const {
+        // returns the number of messages we've refused so far
+        return refusals;
+    }
+    void rebase(std::int64_t from, std::int64_t to) {
+        // moves restored message times onto a new clock, on which the old clock's from reads to.
+        // after a reboot the steady clock starts again near zero, and times from before it would never expire
+        if (startTime != 0) startTime += to - from;
     }
 private:
-    // we measure time starting from the instantiation of this class
-    std::chrono::time_point<std::chrono::system_clock> startTime = std::chrono::system_clock::now();
-    std::deque<double> messageTimes;
-    long messagesPerSecond = 50;
+    // we measure time starting from the first message we send
+    std::int64_t startTime = 0;
+    std::array<std::int64_t, maxMessagesPerSecond> messageTimes = {};
+    std::size_t oldest = 0, count = 0; // the ring holds count times, starting at oldest
+    std::size_t messagesPerSecond = 50;
+    unsigned long refusals = 0;
 };
 
 #endif //READY_TRADER_GO_2024_RATE_LIMITER_H
@@ -0,0 +1,63 @@
+#ifndef READY_TRADER_GO_2024_REACTION_TABLE_H
+#define READY_TRADER_GO_2024_REACTION_TABLE_H
+
+#include <array>
+#include <vector>
+
+/* Our reaction to a futures move is fully determined by our live orders and last quotes.
+ * So after each tick we precompute the reaction to the most likely next moves, and on the next futures book
+ * we only have to look up what to send. */
+
+struct QuoteReaction {
+    /* The quotes to send, and the orders to cancel, for one futures move */
+    long bidPrice = 0, askPrice = 0;
+    std::vector<unsigned long> bidCancels, askCancels;
+};
+
+class ReactionTable {
+public:
+    // futures mids move in half ticks, as the mid of a book with an odd spread lies between two ticks
+    static constexpr long stepSize = 50;
+    static constexpr long maxSteps = 6; // so we precompute moves of up to three ticks either way
+
+    void reset(long mid) {
+        /* clears every entry, and centres the table on the given mid */
+        baseMid = mid;
+        for (QuoteReaction &reaction: reactions) {
+            reaction.bidCancels.clear();
+            reaction.askCancels.clear();
+        }
+        valid = true;
+    }
+    void reserve(std::size_t orders) {
+        /* sizes every entry up front, so building the table doesn't allocate */
+        for (QuoteReaction &reaction: reactions) {
+            reaction.bidCancels.reserve(orders);
+            reaction.askCancels.reserve(orders);
+        }
+    }
+    void invalidate() {
+        /* called when our orders change under the table */
+        valid = false;
+    }
+    QuoteReaction &at(long step) {
+        return reactions[step + maxSteps];
+    }
+    const QuoteReaction *lookup(long mid) const {
+        /* returns the reaction to a move to the given mid, or nullptr if it wasn't precomputed */
+        if (!valid) return nullptr;
+
+        long move = mid - baseMid;
+        if (move % stepSize != 0) return nullptr;
+
+        long step = move / stepSize;
+        if ((step < -maxSteps) || (step > maxSteps)) return nullptr;
+        return &reactions[step + maxSteps];
+    }
+private:
+    std::array<QuoteReaction, 2 * maxSteps + 1> reactions;
+    long baseMid = 0;
+    bool valid = false;
+};
+
+#endif //READY_TRADER_GO_2024_REACTION_TABLE_H
@@ -16,8 +16,10 @@ private:
     Time* time;
     Logger* logger;
 
-    std::vector<Order> filledOrders; // all orders filled
+    std::vector<Order> filledOrders; // all orders filled, or the most recent if we are bounded
     std::deque<Order> unmatchedBids, unmatchedAsks; // orders waiting to be matched
+    unsigned long totalFilled = 0;
+    MemoryBudget budget;
     void settleFilledOrders() {
         /* match orders as they are filled to work out realised profit */
         while ((!unmatchedBids.empty()) && (!unmatchedAsks.empty())) {
@@ -37,19 +39,54 @@ private:
             if (ask.size != 0) unmatchedAsks.push_front(ask);
         }
     }
+    void boundUnmatched(std::deque<Order> &unmatched) {
+        /* if we've built up too many unmatched fills on one side, merge the oldest two into one at their average price */
+        while ((budget.unmatchedCapacity != 0) && (unmatched.size() > budget.unmatchedCapacity)) {
+            Order first = unmatched.front();
+            unmatched.pop_front();
+            Order &second = unmatched.front();
+
+            unsigned long size = first.size + second.size;
+            second.price = (first.price * first.size + second.price * second.size + size / 2) / size;
+            second.size = size;
+        }
+    }
 public:
-    TradeMatcher(Time *timeIn, Logger *loggerIn): time(timeIn), logger(loggerIn) {
+    TradeMatcher(Time *timeIn, Logger *loggerIn, MemoryBudget budgetIn = MemoryBudget::unbounded()):
+        time(timeIn), logger(loggerIn), budget(budgetIn) {
 
     }
     std::vector<Order> *getFilledOrders() {
         return &filledOrders;
     }
+    void save(CheckpointWriter &writer) const {
+        writer.write(filledOrders);
+        writer.write(unmatchedBids);
+        writer.write(unmatchedAsks);
+        writer.write(totalFilled);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(filledOrders);
+        reader.read(unmatchedBids);
+        reader.read(unmatchedAsks);
+        reader.read(totalFilled);
+    }
+    unsigned long getFilledCount() const {
+        /* returns the number of orders ever filled, including any we no longer hold */
+        return totalFilled;
+    }
     void push(Order order) {
         filledOrders.emplace_back(order);
+        totalFilled ++;
+        if ((budget.filledOrdersCapacity != 0) && (filledOrders.size() >= 2 * budget.filledOrdersCapacity))
+            filledOrders.erase(filledOrders.begin(), filledOrders.end() - budget.filledOrdersCapacity);
+
         if (order.side == Side::BUY) unmatchedBids.push_back(order);
         else if (order.side == Side::SELL) unmatchedAsks.push_back(order);
 
         settleFilledOrders();
+        boundUnmatched(unmatchedBids);
+        boundUnmatched(unmatchedAsks);
     }
 };
 
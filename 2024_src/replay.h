@@ -0,0 +1,87 @@
+#ifndef READY_TRADER_GO_2024_REPLAY_H
+#define READY_TRADER_GO_2024_REPLAY_H
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+#include "autotrader.h"
+
+/* Feeds journaled callbacks back into a trader. Shared by journal_player.cc and the Python bindings */
+
+static inline std::array<unsigned long, TOP_LEVEL_COUNT> toArray(const std::array<std::uint64_t, TOP_LEVEL_COUNT> &in) {
+    std::array<unsigned long, TOP_LEVEL_COUNT> out;
+    std::copy(in.begin(), in.end(), out.begin());
+    return out;
+}
+
+static inline void dispatch(AutoTrader &trader, const JournalRecord &record) {
+    /* calls the handler the record was journaled from */
+    Instrument instrument = (Instrument) record.instrument;
+    switch (record.event) {
+        case JournalEvent::OrderBook:
+            trader.OrderBookMessageHandler(instrument, record.id, toArray(record.askPrices), toArray(record.askVolumes),
+                                           toArray(record.bidPrices), toArray(record.bidVolumes));
+            break;
+        case JournalEvent::TradeTicks:
+            trader.TradeTicksMessageHandler(instrument, record.id, toArray(record.askPrices), toArray(record.askVolumes),
+                                            toArray(record.bidPrices), toArray(record.bidVolumes));
+            break;
+        case JournalEvent::OrderFilled:
+            trader.OrderFilledMessageHandler(record.id, record.price, record.volume);
+            break;
+        case JournalEvent::HedgeFilled:
+            trader.HedgeFilledMessageHandler(record.id, record.price, record.volume);
+            break;
+        case JournalEvent::OrderStatus:
+            trader.OrderStatusMessageHandler(record.id, record.volume, record.remainingVolume, record.fees);
+            break;
+        case JournalEvent::Error:
+            trader.ErrorMessageHandler(record.id, std::string(record.message));
+            break;
+        case JournalEvent::Disconnect:
+            trader.DisconnectHandler();
+            break;
+        default:
+            break;
+    }
+}
+
+static inline std::vector<JournalRecord> replayRecords(AutoTrader &trader, const std::vector<JournalRecord> &records) {
+    /* Feeds the inbound records from where the trader's journal is up to, each at the time it was received, and
+     * returns the outbound records the session sent from there, to check the trader's against.
+     *
+     * A Params record follows the callback whose handler adopted it, so it's published before that callback is
+     * dispatched. Those from before the start, or before the first callback, are published as we reach them */
+    std::uint64_t startIndex = trader.getJournal().getNextIndex();
+    std::vector<JournalRecord> recordedOutbound;
+    std::size_t published = 0; // the Params records before this index have been published
+    for (std::size_t i = 0; i < records.size(); i++) {
+        const JournalRecord &record = records[i];
+        if (record.event == JournalEvent::Params) {
+            if (i >= published) trader.replayParams(record);
+            continue;
+        }
+        if (record.index < startIndex) continue;
+        if (record.isOutbound()) {
+            recordedOutbound.emplace_back(record);
+            continue;
+        }
+
+        for (published = i + 1; published < records.size(); published++) {
+            const JournalRecord &next = records[published];
+            if (next.event == JournalEvent::Params) trader.replayParams(next);
+            else if (!next.isOutbound()) break;
+        }
+        trader.getJournal().setReplayTime(record.timestamp);
+        dispatch(trader, record);
+    }
+    return recordedOutbound;
+}
+
+static inline bool sameMessage(const JournalRecord &a, const JournalRecord &b) {
+    return (a.event == b.event) && (a.id == b.id) && (a.instrument == b.instrument) && (a.side == b.side) &&
+           (a.price == b.price) && (a.volume == b.volume) && (a.lifespan == b.lifespan);
+}
+
+#endif //READY_TRADER_GO_2024_REPLAY_H
@@ -0,0 +1,204 @@
+#ifndef READY_TRADER_GO_2024_RISK_GATE_H
+#define READY_TRADER_GO_2024_RISK_GATE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <ready_trader_go/types.h>
+#include "checkpoint.h"
+#include "journal.h"
+
+/* Pre-trade risk checks, run on every order we send.
+ *
+ * Rather than working out our exposure when an order is checked, we keep how many more lots we could buy or sell,
+ * per instrument and across both, and update it as orders are sent, filled and closed. A check is then a few array
+ * reads and a min. The worst case for a side assumes every open order on it fills, as the exchange does.
+ *
+ * Lots, orders and notional sent are also counted over the last second, in eight rolling buckets, so we can cap the
+ * volume we send however the message limit is set. Prices must lie within a band of the fair value. Hedges that bring
+ * our combined position towards flat are only held to the futures position limit, so we're never left unhedged. */
+
+class RiskGate {
+public:
+    static constexpr std::int64_t windowLength = journalTicksPerSecond;
+    static constexpr int bucketCount = 8;
+    static constexpr std::int64_t bucketLength = windowLength / bucketCount;
+
+    RiskGate() {
+        recompute();
+    }
+
+    void setLimits(long positionLimitIn, long combinedLimitIn, long maxLotsPerSecondIn, long priceBandIn) {
+        positionLimit = positionLimitIn;
+        combinedLimit = combinedLimitIn;
+        maxLotsPerSecond = maxLotsPerSecondIn;
+        priceBand = priceBandIn;
+        recompute();
+    }
+    void setFairValue(long fairValueIn) {
+        fairValue = fairValueIn;
+    }
+
+    long getAllowedSize(ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side, long size, std::int64_t eventTime) {
+        /* the most of size we can send now, which may be zero or less */
+        advance(eventTime);
+        long allowed = std::min({size, headroom[(int) instrument][(int) side], combinedHeadroom[(int) side],
+                                 maxLotsPerSecond - windowLots});
+        refusals[Refusal::Size] += allowed < size;
+        return allowed;
+    }
+    bool reducesExposure(ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side, long size) const {
+        /* whether the order is a hedge that brings our combined position closer to flat */
+        if (instrument != ReadyTraderGo::Instrument::FUTURE) return false;
+        long combined = position[0] + position[1];
+        long after = combined + (side == ReadyTraderGo::Side::BUY ? size : -size);
+        return std::labs(after) < std::labs(combined);
+    }
+    long getAllowedHedgeSize(ReadyTraderGo::Side side, long size) {
+        /* The most of a hedge that reduces our exposure we can send. Only the futures position limit applies, the lot
+         * cap and price band must never leave us unhedged */
+        long allowed = std::min(size, headroom[(int) ReadyTraderGo::Instrument::FUTURE][(int) side]);
+        refusals[Refusal::Size] += allowed < size;
+        return allowed;
+    }
+    bool inBand(long price) {
+        /* whether the price is near enough the fair value. Until we have one, anything goes */
+        bool ok = (fairValue == 0) | (std::labs(price - fairValue) <= priceBand);
+        refusals[Refusal::Band] += !ok;
+        return ok;
+    }
+
+    void onSend(ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side, long size, long price, std::int64_t eventTime) {
+        advance(eventTime);
+        open[(int) instrument][(int) side] += size;
+        Bucket &bucket = buckets[slot(currentBucket)];
+        bucket.lots += size;
+        bucket.orders ++;
+        bucket.notional += size * price;
+        windowLots += size;
+        windowOrders ++;
+        windowNotional += size * price;
+        recompute();
+    }
+    void onFill(ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side, long volume) {
+        open[(int) instrument][(int) side] -= volume;
+        position[(int) instrument] += side == ReadyTraderGo::Side::BUY ? volume : -volume;
+        recompute();
+    }
+    void onClose(ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side, long remainingVolume) {
+        open[(int) instrument][(int) side] -= remainingVolume;
+        recompute();
+    }
+
+    long getHeadroom(ReadyTraderGo::Instrument instrument, ReadyTraderGo::Side side) const {
+        return headroom[(int) instrument][(int) side];
+    }
+    long getCombinedHeadroom(ReadyTraderGo::Side side) const {
+        return combinedHeadroom[(int) side];
+    }
+    long getPosition(ReadyTraderGo::Instrument instrument) const {
+        return position[(int) instrument];
+    }
+    unsigned long getRefusals() const {
+        /* orders cut down or refused so far, for any reason */
+        return refusals[Refusal::Size] + refusals[Refusal::Band];
+    }
+
+    void save(CheckpointWriter &writer) const {
+        writer.write(position);
+        writer.write(open);
+        writer.write(buckets);
+        writer.write(currentBucket);
+        writer.write(windowLots);
+        writer.write(windowOrders);
+        writer.write(windowNotional);
+        writer.write(fairValue);
+        writer.write(refusals);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(position);
+        reader.read(open);
+        reader.read(buckets);
+        reader.read(currentBucket);
+        reader.read(windowLots);
+        reader.read(windowOrders);
+        reader.read(windowNotional);
+        reader.read(fairValue);
+        reader.read(refusals);
+        recompute();
+    }
+    void rebase(std::int64_t from, std::int64_t to) {
+        /* Moves the restored window onto a new clock, on which the old clock's from reads to. After a reboot the
+         * steady clock starts again near zero, and advance would ignore every bucket until it caught up */
+        std::int64_t shift = to / bucketLength - from / bucketLength;
+        std::array<Bucket, bucketCount> moved;
+        for (std::int64_t i = 0; i < bucketCount; i++) moved[slot(i + shift)] = buckets[i];
+        buckets = moved;
+        currentBucket += shift; // may be negative, if we rebased onto a clock that's only just started
+    }
+    void print() const {
+        std::cout << "------=+ Risk gate +=------" << std::endl;
+        std::cout << "    - Headroom: future buy " << headroom[0][1] << " sell " << headroom[0][0]
+                  << ", ETF buy " << headroom[1][1] << " sell " << headroom[1][0]
+                  << ", combined buy " << combinedHeadroom[1] << " sell " << combinedHeadroom[0] << std::endl;
+        std::cout << "    - Last second: " << windowOrders << " orders, " << windowLots << " lots, notional " << windowNotional << std::endl;
+        std::cout << "    - Orders cut down in size: " << refusals[Refusal::Size] << ", refused for price: " << refusals[Refusal::Band] << std::endl;
+        std::cout << std::endl;
+    }
+private:
+    struct Bucket {
+        long lots = 0, orders = 0, notional = 0;
+    };
+    enum Refusal { Size, Band, Count };
+
+    long positionLimit = ReadyTraderGo::TradingParameters::positionLimit;
+    long combinedLimit = 2 * ReadyTraderGo::TradingParameters::positionLimit;
+    long maxLotsPerSecond = 5000;
+    long priceBand = 2000;
+    long fairValue = 0;
+
+    // by instrument, then side, as the exchange numbers them
+    std::array<long, 2> position = {};
+    std::array<std::array<long, 2>, 2> open = {};
+    std::array<std::array<long, 2>, 2> headroom = {};
+    std::array<long, 2> combinedHeadroom = {};
+
+    std::array<Bucket, bucketCount> buckets = {};
+    std::int64_t currentBucket = 0; // eventTime / bucketLength, of the last bucket we added to
+    long windowLots = 0, windowOrders = 0, windowNotional = 0; // summed over the buckets
+    std::array<unsigned long, Refusal::Count> refusals = {};
+
+    void recompute() {
+        /* a buy is limited by our position and open bids, a sell by our position and open asks */
+        const int sell = (int) ReadyTraderGo::Side::SELL, buy = (int) ReadyTraderGo::Side::BUY;
+        for (int instrument = 0; instrument < 2; instrument++) {
+            headroom[instrument][buy] = positionLimit - position[instrument] - open[instrument][buy];
+            headroom[instrument][sell] = positionLimit + position[instrument] - open[instrument][sell];
+        }
+        long combinedPosition = position[0] + position[1];
+        combinedHeadroom[buy] = combinedLimit - combinedPosition - open[0][buy] - open[1][buy];
+        combinedHeadroom[sell] = combinedLimit + combinedPosition - open[0][sell] - open[1][sell];
+    }
+    static std::size_t slot(std::int64_t bucket) {
+        /* where a bucket lives in buckets. Positive, even for a bucket from before a rebased clock started */
+        return (std::size_t) ((bucket % bucketCount + bucketCount) % bucketCount);
+    }
+    void advance(std::int64_t eventTime) {
+        /* empties the buckets that have fallen out of the window. At most bucketCount of them, however long it's been */
+        std::int64_t bucket = eventTime / bucketLength;
+        if (bucket <= currentBucket) return;
+        std::int64_t first = std::max(currentBucket + 1, bucket - bucketCount + 1);
+        for (std::int64_t expired = first; expired <= bucket; expired++) {
+            Bucket &old = buckets[slot(expired)];
+            windowLots -= old.lots;
+            windowOrders -= old.orders;
+            windowNotional -= old.notional;
+            old = Bucket();
+        }
+        currentBucket = bucket;
+    }
+};
+
+#endif //READY_TRADER_GO_2024_RISK_GATE_H
@@ -0,0 +1,204 @@
+//
+// Python bindings for the journal reader, the fair value and signal code, and journal replay, so the notebooks in
+// 2024_analysis/signal_analysis can run the production code over whole sessions rather than re-implementing it.
+// Build: c++ -O2 -std=c++17 -shared -fPIC $(python3 -m pybind11 --includes) rtg_python.cc autotrader.cc
+//            -lready_trader_go -lpthread -o rtg$(python3-config --extension-suffix)
+// e.g.   import rtg
+//        books = rtg.read_journal("custom_log/journal.bin", [rtg.JournalEvent.OrderBook])
+//        mids = rtg.inverse_vwap(books["ask_prices"], books["ask_volumes"], books["bid_prices"], books["bid_volumes"])
+// Every array returned is a NumPy view onto memory the C++ side allocated, which the view keeps alive, so nothing is
+// copied on the way out. The loops release the GIL.
+//
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include <boost/asio/io_context.hpp>
+#include "replay.h"
+
+namespace py = pybind11;
+
+typedef std::vector<JournalRecord> RecordList;
+typedef py::array_t<std::uint64_t, py::array::forcecast> LevelArray;
+
+template <typename Field>
+static py::array recordColumn(const RecordList &records, std::size_t offset, const py::capsule &owner) {
+    /* a strided view onto one field of every record */
+    const char *base = reinterpret_cast<const char*>(records.data()) + offset;
+    return py::array_t<Field>({(py::ssize_t) records.size()}, {(py::ssize_t) sizeof(JournalRecord)},
+                              reinterpret_cast<const Field*>(base), owner);
+}
+
+static py::array levelColumn(const RecordList &records, std::size_t offset, const py::capsule &owner) {
+    /* a strided (records x levels) view onto one of the book arrays of every record */
+    const char *base = reinterpret_cast<const char*>(records.data()) + offset;
+    return py::array_t<std::uint64_t>({(py::ssize_t) records.size(), (py::ssize_t) TOP_LEVEL_COUNT},
+                                      {(py::ssize_t) sizeof(JournalRecord), (py::ssize_t) sizeof(std::uint64_t)},
+                                      reinterpret_cast<const std::uint64_t*>(base), owner);
+}
+
+static py::dict toColumns(RecordList *records) {
+    /* Hands ownership of the records to Python. Each column is a view onto them, and the last view to go frees them */
+    py::capsule owner(records, [](void *pointer) { delete reinterpret_cast<RecordList*>(pointer); });
+
+    py::dict columns;
+    columns["index"] = recordColumn<std::uint64_t>(*records, offsetof(JournalRecord, index), owner);
+    columns["timestamp"] = recordColumn<std::int64_t>(*records, offsetof(JournalRecord, timestamp), owner);
+    columns["event"] = recordColumn<std::uint8_t>(*records, offsetof(JournalRecord, event), owner);
+    columns["instrument"] = recordColumn<std::uint8_t>(*records, offsetof(JournalRecord, instrument), owner);
+    columns["side"] = recordColumn<std::uint8_t>(*records, offsetof(JournalRecord, side), owner);
+    columns["lifespan"] = recordColumn<std::uint8_t>(*records, offsetof(JournalRecord, lifespan), owner);
+    columns["id"] = recordColumn<std::uint64_t>(*records, offsetof(JournalRecord, id), owner);
+    columns["price"] = recordColumn<std::uint64_t>(*records, offsetof(JournalRecord, price), owner);
+    columns["volume"] = recordColumn<std::uint64_t>(*records, offsetof(JournalRecord, volume), owner);
+    columns["remaining_volume"] = recordColumn<std::uint64_t>(*records, offsetof(JournalRecord, remainingVolume), owner);
+    columns["fees"] = recordColumn<std::int64_t>(*records, offsetof(JournalRecord, fees), owner);
+    columns["ask_prices"] = levelColumn(*records, offsetof(JournalRecord, askPrices), owner);
+    columns["ask_volumes"] = levelColumn(*records, offsetof(JournalRecord, askVolumes), owner);
+    columns["bid_prices"] = levelColumn(*records, offsetof(JournalRecord, bidPrices), owner);
+    columns["bid_volumes"] = levelColumn(*records, offsetof(JournalRecord, bidVolumes), owner);
+    return columns;
+}
+
+static py::dict readJournalColumns(const std::string &path, const std::vector<JournalEvent> &events) {
+    /* reads a journal, keeping only the given events if any are given */
+    std::unique_ptr<RecordList> records(new RecordList());
+    {
+        py::gil_scoped_release release;
+        *records = readJournal(path);
+        if (!events.empty()) {
+            records->erase(std::remove_if(records->begin(), records->end(), [&](const JournalRecord &record) {
+                return std::find(events.begin(), events.end(), record.event) == events.end();
+            }), records->end());
+        }
+    }
+    return toColumns(records.release());
+}
+
+static py::array_t<double> inverseVWAP(LevelArray askPrices, LevelArray askVolumes, LevelArray bidPrices,
+                                       LevelArray bidVolumes, Instrument instrument) {
+    /* The fair value the trader would have had after each book, or NaN where a side is empty. Rows are fed in order
+     * through one estimator, so its caching behaves as it does live */
+    auto asks = askPrices.unchecked<2>(), askSizes = askVolumes.unchecked<2>();
+    auto bids = bidPrices.unchecked<2>(), bidSizes = bidVolumes.unchecked<2>();
+    py::ssize_t rows = asks.shape(0);
+    for (const auto *levels: {&asks, &askSizes, &bids, &bidSizes})
+        if ((levels->shape(0) != rows) || (levels->shape(1) != TOP_LEVEL_COUNT))
+            throw std::invalid_argument("expected four (books x 5) arrays");
+
+    py::array_t<double> mids(rows);
+    auto out = mids.mutable_unchecked<1>();
+    {
+        py::gil_scoped_release release;
+        MarketStream stream;
+        InverseVWAP estimator;
+        estimator.setStream(&stream);
+        std::array<unsigned long, TOP_LEVEL_COUNT> a, av, b, bv;
+        for (py::ssize_t row = 0; row < rows; row++) {
+            for (int i = 0; i < TOP_LEVEL_COUNT; i++) {
+                a[i] = asks(row, i);
+                av[i] = askSizes(row, i);
+                b[i] = bids(row, i);
+                bv[i] = bidSizes(row, i);
+            }
+            std::optional<long> mid = estimator.calculateMid(instrument, a, av, b, bv);
+            out(row) = mid.has_value() ? (double) mid.value() : std::nan("");
+        }
+    }
+    return mids;
+}
+
+static py::array_t<std::int8_t> repeatedTradeMomentum(py::array_t<double, py::array::forcecast> fillTimes,
+                                                       py::array_t<std::uint8_t, py::array::forcecast> fillSides,
+                                                       py::array_t<double, py::array::forcecast> times) {
+    /* RepeatedTradeMomentum at each of the given times, having seen the fills up to then: 1 for an upwards trend,
+     * -1 for downwards, else 0. Fills and times must be in time order, sides are 0 for sell and 1 for buy */
+    auto fillTime = fillTimes.unchecked<1>(), queryTime = times.unchecked<1>();
+    auto fillSide = fillSides.unchecked<1>();
+    if (fillSide.shape(0) != fillTime.shape(0)) throw std::invalid_argument("expected a side for every fill");
+
+    py::array_t<std::int8_t> signals(queryTime.shape(0));
+    auto out = signals.mutable_unchecked<1>();
+    {
+        py::gil_scoped_release release;
+        Time time = Time::getInstance();
+        time.advanceTime(-time.getTime());
+        Logger logger(false);
+        TradeMatcher matcher(&time, &logger);
+        RepeatedTradeMomentum momentum(&matcher, &logger, &time);
+
+        py::ssize_t nextFill = 0;
+        for (py::ssize_t i = 0; i < queryTime.shape(0); i++) {
+            time.advanceTime(queryTime(i) - time.getTime());
+            for (; (nextFill < fillTime.shape(0)) && (fillTime(nextFill) <= queryTime(i)); nextFill++) {
+                matcher.push(Order(nextFill, 1, 0, (Side) fillSide(nextFill), fillTime(nextFill), Instrument::ETF));
+            }
+            std::optional<Signal> signal = momentum.getSignal();
+            out(i) = !signal.has_value() ? 0 : (signal.value() == up_trend ? 1 : -1);
+        }
+    }
+    return signals;
+}
+
+static py::dict replayJournal(const std::string &path, const std::string &checkpoint) {
+    /* Replays a journal through a fresh trader, as journal_player does, and returns what it sent. The trader reads its
+     * parameters and writes its logs relative to the working directory, as it would live */
+    std::unique_ptr<RecordList> outbound(new RecordList());
+    std::size_t recordedCount = 0, mismatches = 0;
+    {
+        py::gil_scoped_release release;
+        RecordList records = readJournal(path);
+        if (records.empty()) throw std::runtime_error("no records in " + path);
+
+        SessionJournal::replaying() = true;
+        boost::asio::io_context context;
+        AutoTrader trader(context);
+        if (!checkpoint.empty() && !trader.loadCheckpoint(checkpoint))
+            throw std::runtime_error("failed to load checkpoint " + checkpoint);
+        RecordList recorded = replayRecords(trader, records);
+        *outbound = trader.getJournal().getReplayedOutbound();
+
+        recordedCount = recorded.size();
+        for (std::size_t i = 0; i < std::min(recorded.size(), outbound->size()); i++)
+            if (!sameMessage(recorded[i], (*outbound)[i])) mismatches ++;
+    }
+
+    py::dict result;
+    result["outbound"] = toColumns(outbound.release());
+    result["recorded_outbound"] = recordedCount;
+    result["mismatches"] = mismatches;
+    return result;
+}
+
+PYBIND11_MODULE(rtg, module) {
+    module.doc() = "The trader's market data reader, estimators and replay, for research";
+
+    py::enum_<JournalEvent>(module, "JournalEvent")
+            .value("OrderBook", JournalEvent::OrderBook)
+            .value("TradeTicks", JournalEvent::TradeTicks)
+            .value("OrderFilled", JournalEvent::OrderFilled)
+            .value("HedgeFilled", JournalEvent::HedgeFilled)
+            .value("OrderStatus", JournalEvent::OrderStatus)
+            .value("Error", JournalEvent::Error)
+            .value("Disconnect", JournalEvent::Disconnect)
+            .value("Params", JournalEvent::Params)
+            .value("InsertOrder", JournalEvent::InsertOrder)
+            .value("HedgeOrder", JournalEvent::HedgeOrder)
+            .value("CancelOrder", JournalEvent::CancelOrder);
+    py::enum_<Instrument>(module, "Instrument")
+            .value("FUTURE", Instrument::FUTURE)
+            .value("ETF", Instrument::ETF);
+
+    module.def("read_journal", &readJournalColumns, py::arg("path"), py::arg("events") = std::vector<JournalEvent>(),
+               "Reads a session journal into a dict of columns, optionally keeping only some events");
+    module.def("inverse_vwap", &inverseVWAP, py::arg("ask_prices"), py::arg("ask_volumes"), py::arg("bid_prices"),
+               py::arg("bid_volumes"), py::arg("instrument") = Instrument::ETF,
+               "The InverseVWAP fair value after each book, NaN where it has none");
+    module.def("repeated_trade_momentum", &repeatedTradeMomentum, py::arg("fill_times"), py::arg("fill_sides"), py::arg("times"),
+               "The RepeatedTradeMomentum signal at each time: 1 up, -1 down, 0 none");
+    module.def("replay", &replayJournal, py::arg("path"), py::arg("checkpoint") = "",
+               "Replays a journal through a fresh AutoTrader, returning the messages it sent");
+}
@@ -0,0 +1,93 @@
+#ifndef READY_TRADER_GO_2024_RUN_MODE_H
+#define READY_TRADER_GO_2024_RUN_MODE_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <boost/asio/io_context.hpp>
+#include "telemetry.h"
+
+/* The low latency run mode. By default main() calls context.run(), which sleeps in epoll between messages, so every
+ * message first waits for the scheduler to wake us. Calling runLowLatency(context, trader, config) instead busy polls
+ * the io_context on a pinned core, with memory locked, so handlers run as soon as a message lands. */
+
+struct RunModeConfig {
+    int tradingCore = -1; // core to pin the trading thread to, -1 to leave it unpinned
+    int helperCore = -1; // core for the analytics and journal threads, -1 to leave them unpinned
+    bool lockMemory = true; // mlockall, so we never take a page fault on the hot path
+    long prefaultStackBytes = 512 * 1024; // stack to touch up front, so it's already mapped
+};
+
+struct PollLoopStats {
+    /* What the busy poll loop did. The gap between one poll returning and the next starting bounds how long a message
+     * can wait for us once we're idle; time spent in our own handlers is counted apart, in busyPoll */
+    std::uint64_t iterations = 0, busyIterations = 0, handlersRun = 0;
+    LatencyHistogram pollGap; // nanoseconds from the end of one poll to the start of the next
+    std::int64_t maxPollGap = 0;
+    LatencyHistogram busyPoll; // nanoseconds spent in polls that ran handlers
+
+    void print() const {
+        std::cout << "------=+ Poll loop +=------" << std::endl
+                  << "    - Iterations = " << iterations << ", of which ran handlers = " << busyIterations << std::endl
+                  << "    - Handlers run = " << handlersRun << std::endl
+                  << "    - Gap between polls (ns): p50 = " << pollGap.percentile(0.5) << ", p99 = " << pollGap.percentile(0.99)
+                  << ", p99.99 = " << pollGap.percentile(0.9999) << ", max = " << maxPollGap << std::endl
+                  << "    - Polls that ran handlers (ns): p50 = " << busyPoll.percentile(0.5) << ", p99 = " << busyPoll.percentile(0.99)
+                  << std::endl << std::endl;
+    }
+};
+
+static inline bool pinThread(pthread_t thread, int core) {
+    /* pins a thread to a single core. Returns false if we couldn't */
+    if (core < 0) return false;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+}
+
+static inline void prefaultStack(long bytes) {
+    /* touches the next few hundred kB of stack, so the pages are mapped (and with mlockall, locked) before we trade */
+    volatile char *stack = static_cast<volatile char*>(alloca(bytes));
+    for (long i = 0; i < bytes; i += 4096) stack[i] = 0;
+}
+
+template <typename Trader>
+PollLoopStats runLowLatency(boost::asio::io_context &context, Trader &trader, const RunModeConfig &config) {
+    /* Replaces context.run(). Returns once the io_context runs out of work, like run() would */
+    if ((config.tradingCore >= 0) && !pinThread(pthread_self(), config.tradingCore))
+        std::cerr << "couldn't pin the trading thread to core " << config.tradingCore << std::endl;
+    if (config.helperCore >= 0) trader.pinHelperThreads(config.helperCore);
+
+    if (config.lockMemory && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0))
+        std::cerr << "mlockall failed, we may page fault while trading (check RLIMIT_MEMLOCK)" << std::endl;
+    prefaultStack(config.prefaultStackBytes);
+    trader.warmUp();
+
+    PollLoopStats stats;
+    auto lastPollEnd = std::chrono::steady_clock::now();
+    while (!context.stopped()) {
+        auto pollStart = std::chrono::steady_clock::now();
+        std::size_t handlers = context.poll();
+        auto pollEnd = std::chrono::steady_clock::now();
+
+        std::int64_t gap = std::chrono::duration_cast<std::chrono::nanoseconds>(pollStart - lastPollEnd).count();
+        lastPollEnd = pollEnd;
+        stats.iterations ++;
+        stats.pollGap.record(gap);
+        stats.maxPollGap = std::max(stats.maxPollGap, gap);
+        if (handlers > 0) {
+            stats.busyIterations ++;
+            stats.handlersRun += handlers;
+            stats.busyPoll.record(std::chrono::duration_cast<std::chrono::nanoseconds>(pollEnd - pollStart).count());
+        }
+    }
+    return stats;
+}
+
+#endif //READY_TRADER_GO_2024_RUN_MODE_H
@@ -4,6 +4,7 @@
 #include "ready_trader_go/types.h"
 #include <iostream>
 #include <vector>
+#include <array>
 #include <optional>
 #include <math.h>
 #include "order_book.h"
@@ -29,6 +30,11 @@ private:
     TradeMatcher *matchingEngine;
     Logger *logger;
     Time *time;
+
+    // the signal only changes when we get a new fill, or when a fill we counted drops out of the window
+    std::optional<Signal> lastSignal;
+    unsigned long lastFilledCount = 0;
+    double validUntil = -1;
 public:
     RepeatedTradeMomentum(TradeMatcher *matcherIn, Logger *loggerIn, Time *timerIn): matchingEngine(matcherIn), time(timerIn) {}
     std::optional<Signal> getSignal() {
@@ -37,27 +43,103 @@ public:
         static const long tradesForSignal = 2;
 
         std::vector<Order> *filledOrders = matchingEngine->getFilledOrders();
+        if ((matchingEngine->getFilledCount() == lastFilledCount) && (time->getTime() <= validUntil)) return lastSignal;
+
         long bids = 0, asks = 0;
+        validUntil = 1e9;
         for (int i = filledOrders->size() - 1; i >= 0; i--) {
             // break when go too far back in time
             Order order = filledOrders->at(i);
             if (time->getTime() - order.time > timePeriod) break;
+            validUntil = order.time + timePeriod;
 
             if (order.side == Side::BUY) bids ++;
             else if (order.side == Side::SELL) asks ++;
         }
+        lastFilledCount = matchingEngine->getFilledCount();
 
         // if we've been trading on both sides, there is no signal
         if ((bids >= tradesForSignal) && (asks >= tradesForSignal)) {
-            return {};
+            lastSignal = {};
         } else if (bids >= tradesForSignal) {
-            return down_trend;
+            lastSignal = down_trend;
         } else if (asks >= tradesForSignal) {
-            return up_trend;
+            lastSignal = up_trend;
         } else {
-            return {};
+            lastSignal = {};
+        }
+        return lastSignal;
+    }
+};
+class VolumeImbalance : AbstractSignal {
+    /* Level volume imbalance, (bids - asks) / (bids + asks), which the volume_imbalance research found leads the mid.
+     * Levels are weighted less the deeper they are, and we keep the imbalance at every depth. The ETF's full depth
+     * imbalance is smoothed across books, and signals when it passes a threshold.
+     * The weights are whole numbers, so the weighted sums can be updated level by level as volumes change without
+     * drifting, and an unchanged book costs ten compares. */
+private:
+    static constexpr std::array<long, TOP_LEVEL_COUNT> levelWeights = {16, 12, 9, 7, 5}; // roughly 0.75 per level
+    static constexpr double smoothing = 0.5; // weight of the newest book in the moving average
+
+    struct InstrumentImbalance {
+        std::array<unsigned long, TOP_LEVEL_COUNT> askVolumes = {}, bidVolumes = {}; // the last book
+        std::array<long, TOP_LEVEL_COUNT> weightedAsks = {}, weightedBids = {}; // weighted sums over the top depth + 1 levels
+        double smoothed = 0;
+    };
+    InstrumentImbalance etf, future;
+    double threshold = 0.7;
+
+    static void updateSide(std::array<unsigned long, TOP_LEVEL_COUNT> &last, const std::array<unsigned long, TOP_LEVEL_COUNT> &volumes,
+                           std::array<long, TOP_LEVEL_COUNT> &weighted) {
+        /* a level's change moves the sums of every depth that includes it */
+        for (int level = 0; level < TOP_LEVEL_COUNT; level++) {
+            if (volumes[level] == last[level]) continue;
+            long change = levelWeights[level] * ((long) volumes[level] - (long) last[level]);
+            for (int depth = level; depth < TOP_LEVEL_COUNT; depth++) weighted[depth] += change;
+            last[level] = volumes[level];
         }
     }
+    InstrumentImbalance &get(Instrument instrument) {
+        return instrument == Instrument::ETF ? etf : future;
+    }
+    const InstrumentImbalance &get(Instrument instrument) const {
+        return instrument == Instrument::ETF ? etf : future;
+    }
+public:
+    void setThreshold(double thresholdIn) {
+        threshold = thresholdIn;
+    }
+    void onOrderBook(Instrument instrument,
+                     const std::array<unsigned long, TOP_LEVEL_COUNT> &askVolumes,
+                     const std::array<unsigned long, TOP_LEVEL_COUNT> &bidVolumes) {
+        InstrumentImbalance &imbalance = get(instrument);
+        updateSide(imbalance.askVolumes, askVolumes, imbalance.weightedAsks);
+        updateSide(imbalance.bidVolumes, bidVolumes, imbalance.weightedBids);
+        imbalance.smoothed += smoothing * (getImbalance(instrument, TOP_LEVEL_COUNT) - imbalance.smoothed);
+    }
+    double getImbalance(Instrument instrument, int depth) const {
+        /* the weighted imbalance over the top depth levels, between -1 (all asks) and 1 (all bids) */
+        const InstrumentImbalance &imbalance = get(instrument);
+        long bids = imbalance.weightedBids[depth - 1], asks = imbalance.weightedAsks[depth - 1];
+        return bids + asks == 0 ? 0 : (double) (bids - asks) / (double) (bids + asks);
+    }
+    double getSmoothedImbalance(Instrument instrument) const {
+        return get(instrument).smoothed;
+    }
+    std::optional<Signal> getSignal() {
+        /* a book heavy with bids is pushed up, and vice versa */
+        if (etf.smoothed > threshold) return up_trend;
+        if (etf.smoothed < -threshold) return down_trend;
+        return {};
+    }
+    void save(CheckpointWriter &writer) const {
+        writer.write(etf);
+        writer.write(future);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(etf);
+        reader.read(future);
+    }
 };
 class ShortTermMomentum : AbstractSignal {
      /* detects momentum by taking a regression line of the price mid (UNUSED) */
@@ -0,0 +1,89 @@
+#ifndef READY_TRADER_GO_2024_STRATEGY_HOST_H
+#define READY_TRADER_GO_2024_STRATEGY_HOST_H
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <utility>
+#include <ready_trader_go/types.h>
+#include "types.h"
+#include "strategy_params.h"
+
+/* Lets us run extra quoting strategies alongside the main one, e.g. to A/B a change live.
+ *
+ * Each hosted strategy owns a named book in the ETF BooksContainer, and has its own parameters file. The book is
+ * parsed, and the fair value calculated, once per tick by the trader; every strategy is handed the same
+ * MarketSnapshot and only has to say where it would quote. The trader does the order management for them, and
+ * arbitrates between them: each gets a share of the position limit, and they split the message budget the main
+ * strategy leaves spare. */
+
+struct MarketSnapshot {
+    /* Everything the trader worked out about this ETF book, shared between strategies */
+    double time;
+    long quoteMid; // the futures mid, which we quote around
+    long fairValue; // the ETF fair value
+    const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices, &askVolumes, &bidPrices, &bidVolumes;
+};
+
+static inline std::pair<long, long> getPriorityQuotes(long mid, const StrategyParams &params,
+                                                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askPrices,
+                                                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &askVolumes,
+                                                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidPrices,
+                                                      const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> &bidVolumes) {
+    /* The prices closest to a certain orderbook priority, such that we lie between (minSpread, maxSpread) of the mid.
+     * Note the spreads are one-sided, so total spread would be 2*minSpread */
+    Interval bidRange = Interval(mid - params.maxSpread, mid - params.minSpread);
+    Interval askRange = Interval(mid + params.minSpread, mid + params.maxSpread);
+
+    long priorityBid = 0, priorityAsk = 0;
+    long totalBids = 0, totalAsks = 0;
+    for (int i = 0; i < ReadyTraderGo::TOP_LEVEL_COUNT; i++) {
+        totalBids += bidVolumes[i];
+        if ((totalBids >= params.maxBidPriority) && (priorityBid == 0)) {
+            priorityBid = bidPrices[std::max(0, i - 1)];
+        }
+
+        totalAsks += askVolumes[i];
+        if ((totalAsks >= params.maxAskPriority) && (priorityAsk == 0)) {
+            priorityAsk = askPrices[std::max(0, i - 1)];
+        }
+    }
+
+    long bidPrice = priorityBid != 0 ? bidRange.getClosestToValue(priorityBid) : bidRange.lower;
+    long askPrice = priorityAsk != 0 ? askRange.getClosestToValue(priorityAsk) : askRange.upper;
+    return {bidPrice, askPrice};
+}
+
+class QuotingStrategy {
+    /* A strategy hosted alongside the main one. It only decides where to quote */
+public:
+    virtual ~QuotingStrategy() = default;
+
+    // returns the bid/ ask prices to quote at, with 0 for a side we don't want to quote
+    virtual std::pair<long, long> getQuotes(const MarketSnapshot &snapshot, const StrategyParams &params) = 0;
+};
+
+class PriorityQuoter : public QuotingStrategy {
+    /* The main strategy's priority quotes, without the momentum adjustment. Useful as a control */
+public:
+    std::pair<long, long> getQuotes(const MarketSnapshot &snapshot, const StrategyParams &params) override {
+        return getPriorityQuotes(snapshot.quoteMid, params, snapshot.askPrices, snapshot.askVolumes,
+                                 snapshot.bidPrices, snapshot.bidVolumes);
+    }
+};
+
+struct HostedStrategy {
+    /* A strategy, and what the host needs to run it */
+    const std::string name; // also the name of its book
+    std::unique_ptr<QuotingStrategy> strategy;
+    StrategyParamStore params; // read from strategy_params_<name>.cfg
+    const StrategyParams *adopted = nullptr; // the block we last journaled
+    const double positionShare; // the fraction of the position limit this strategy may use
+
+    HostedStrategy(const std::string &nameIn, std::unique_ptr<QuotingStrategy> strategyIn, double positionShareIn, bool watchParams):
+        name(nameIn), strategy(std::move(strategyIn)), params("strategy_params_" + nameIn + ".cfg", watchParams),
+        positionShare(positionShareIn) {}
+};
+
+#endif //READY_TRADER_GO_2024_STRATEGY_HOST_H
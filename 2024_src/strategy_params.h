@@ -0,0 +1,237 @@
+#ifndef READY_TRADER_GO_2024_STRATEGY_PARAMS_H
+#define READY_TRADER_GO_2024_STRATEGY_PARAMS_H
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+/* The strategy's tuning parameters, which can be changed while we trade.
+ *
+ * They're read from a "key = value" file, which a watcher thread checks every so often. When it changes, the new
+ * parameters are validated and published through an atomic pointer, RCU style: the trading thread picks the latest
+ * block up with a single acquire load at the start of each callback, and an old block is only freed once the trading
+ * thread has moved on to a newer one. */
+
+struct StrategyParams {
+    unsigned long generation = 0; // bumped on every reload
+
+    long messageSpeed = 4; // see MessageFrequencyLimiter::setSpeed
+
+    /* Quoting, see getOrderPrices */
+    long minSpread = 150, maxSpread = 500; // one-sided, so total spread would be 2*minSpread
+    long maxBidPriority = 100, maxAskPriority = 100;
+    long momentumSlippage = 300; // how far we pull the quote on the side a trend is moving towards
+    long momentumLean = 100; // and how far we move the other side with it
+    long imbalanceThreshold = 70; // percent of book volume imbalance at which we lean, see VolumeImbalance
+    long imbalanceLean = 100; // how far we move both quotes towards a lopsided book
+
+    /* Stale orders, see isStaleBid/ isStaleAsk */
+    long allowedUncompetitiveSlippage = 100;
+    long staleMinSpread = 50; // half sided
+
+    /* Order sizes, see topUpQuotes */
+    long lotSize = 50;
+    long maxSubmittedOrders = 50;
+
+    long hedgeSpread = 100; // see hedge
+    long requoteThreshold = 100; // see onFutureMidMove
+
+    /* Pre-trade risk, see RiskGate */
+    long combinedPositionLimit = 200; // on the ETF and futures positions together, counting open orders
+    long maxLotsPerSecond = 5000; // sent, across both instruments
+    long priceBand = 2000; // how far from the fair value we'll send an order
+
+    std::string validate() const {
+        /* returns why these parameters can't be traded with, or an empty string if they can */
+        if ((messageSpeed < 1) || (messageSpeed > 10)) return "messageSpeed must be between 1 and 10";
+        if ((minSpread <= 0) || (maxSpread < minSpread)) return "need 0 < minSpread <= maxSpread";
+        if ((maxBidPriority < 0) || (maxAskPriority < 0)) return "priorities can't be negative";
+        if ((momentumSlippage < 0) || (momentumLean < 0)) return "momentum adjustments can't be negative";
+        if ((imbalanceThreshold <= 0) || (imbalanceThreshold > 100)) return "imbalanceThreshold must be between 1 and 100";
+        if (imbalanceLean < 0) return "imbalanceLean can't be negative";
+        if ((allowedUncompetitiveSlippage < 0) || (staleMinSpread < 0)) return "stale order thresholds can't be negative";
+        if ((lotSize <= 0) || (lotSize > 100)) return "lotSize must be between 1 and the position limit";
+        if (maxSubmittedOrders < lotSize) return "maxSubmittedOrders must be at least lotSize";
+        if (hedgeSpread < 0) return "hedgeSpread can't be negative";
+        if (requoteThreshold <= 0) return "requoteThreshold must be positive";
+        if (combinedPositionLimit <= 0) return "combinedPositionLimit must be positive";
+        if (maxLotsPerSecond <= 0) return "maxLotsPerSecond must be positive";
+        if (priceBand <= 0) return "priceBand must be positive";
+        return "";
+    }
+};
+
+struct StrategyParamField {
+    const char *name;
+    long StrategyParams::*field;
+};
+static const StrategyParamField strategyParamFields[] = {
+    {"messageSpeed", &StrategyParams::messageSpeed},
+    {"minSpread", &StrategyParams::minSpread},
+    {"maxSpread", &StrategyParams::maxSpread},
+    {"maxBidPriority", &StrategyParams::maxBidPriority},
+    {"maxAskPriority", &StrategyParams::maxAskPriority},
+    {"momentumSlippage", &StrategyParams::momentumSlippage},
+    {"momentumLean", &StrategyParams::momentumLean},
+    {"imbalanceThreshold", &StrategyParams::imbalanceThreshold},
+    {"imbalanceLean", &StrategyParams::imbalanceLean},
+    {"allowedUncompetitiveSlippage", &StrategyParams::allowedUncompetitiveSlippage},
+    {"staleMinSpread", &StrategyParams::staleMinSpread},
+    {"lotSize", &StrategyParams::lotSize},
+    {"maxSubmittedOrders", &StrategyParams::maxSubmittedOrders},
+    {"hedgeSpread", &StrategyParams::hedgeSpread},
+    {"requoteThreshold", &StrategyParams::requoteThreshold},
+    {"combinedPositionLimit", &StrategyParams::combinedPositionLimit},
+    {"maxLotsPerSecond", &StrategyParams::maxLotsPerSecond},
+    {"priceBand", &StrategyParams::priceBand},
+};
+
+static inline std::string parseStrategyParams(std::istream &in, StrategyParams &params) {
+    /* Reads "key = value" lines over the given defaults. Blank lines and lines starting with # are skipped.
+     * Returns an error, or an empty string on success */
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber ++;
+        std::size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::size_t equals = line.find('=');
+        if (equals == std::string::npos) return "line " + std::to_string(lineNumber) + ": expected key = value";
+        std::string key, rest;
+        long value;
+        std::istringstream keyStream(line.substr(0, equals)), valueStream(line.substr(equals + 1));
+        keyStream >> key;
+        if (!(valueStream >> value) || (valueStream >> rest))
+            return "line " + std::to_string(lineNumber) + ": " + key + " needs a whole number";
+
+        bool known = false;
+        for (const StrategyParamField &field: strategyParamFields) {
+            if (key == field.name) {
+                params.*field.field = value;
+                known = true;
+            }
+        }
+        if (!known) return "line " + std::to_string(lineNumber) + ": unknown parameter " + key;
+    }
+    return "";
+}
+
+class StrategyParamStore {
+public:
+    StrategyParamStore(const std::string &pathIn, bool watch): path(pathIn) {
+        /* Starts from the defaults, overridden by the file if there is one */
+        StrategyParams *initial = new StrategyParams();
+        std::string error = readFile(*initial);
+        if (!error.empty()) {
+            std::cerr << "ignoring " << path << ": " << error << std::endl;
+            *initial = StrategyParams();
+        }
+        current.store(initial, std::memory_order_release);
+        blocks.push_back(initial);
+
+        if (watch) watcher = std::thread([this] { watchLoop(); });
+    }
+    ~StrategyParamStore() {
+        running.store(false, std::memory_order_release);
+        if (watcher.joinable()) watcher.join();
+        for (const StrategyParams *block: blocks) delete block;
+    }
+    StrategyParamStore(const StrategyParamStore&) = delete;
+    StrategyParamStore &operator=(const StrategyParamStore&) = delete;
+
+    const StrategyParams *enter() {
+        /* Trading thread only, at the start of each callback. Returns the latest parameters, which stay valid until
+         * the next call. Since the trading thread holds one block at a time, taking a new one releases every older one */
+        const StrategyParams *latest = current.load(std::memory_order_acquire);
+        held.store(latest->generation, std::memory_order_release);
+        return latest;
+    }
+    std::string reload() {
+        /* Rereads the file, and publishes the result if it's valid. Called by the watcher, but safe from any thread */
+        // a key removed from the file goes back to its default
+        StrategyParams next;
+        std::string error = readFile(next);
+        if (!error.empty()) return error;
+        publish(next);
+        return "";
+    }
+    void publish(const StrategyParams &next) {
+        /* Makes next the latest parameters, under a new generation. The journal player publishes the blocks the
+         * journal says were adopted live through here, rather than reading the file */
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        StrategyParams *published = new StrategyParams(next);
+        published->generation = current.load(std::memory_order_acquire)->generation + 1;
+        current.store(published, std::memory_order_release);
+        blocks.push_back(published);
+        reclaim();
+    }
+
+    const std::string &getPath() const {
+        return path;
+    }
+    std::thread &getWatcher() {
+        /* not joinable if we aren't watching the file */
+        return watcher;
+    }
+private:
+    const std::string path;
+    std::atomic<const StrategyParams*> current = nullptr;
+    std::atomic<unsigned long> held = 0; // generation of the block the trading thread holds
+
+    std::mutex reloadMutex; // guards blocks
+    std::vector<const StrategyParams*> blocks; // every block not yet freed, oldest first
+    std::atomic<bool> running = true;
+    std::thread watcher;
+
+    std::string readFile(StrategyParams &params) const {
+        std::ifstream file(path);
+        if (!file.is_open()) return "";
+        std::string error = parseStrategyParams(file, params);
+        if (error.empty()) error = params.validate();
+        return error;
+    }
+    void reclaim() {
+        /* frees the blocks older than the one the trading thread holds */
+        unsigned long oldestHeld = held.load(std::memory_order_acquire);
+        while ((blocks.size() > 1) && (blocks.front()->generation < oldestHeld)) {
+            delete blocks.front();
+            blocks.erase(blocks.begin());
+        }
+    }
+    void watchLoop() {
+        static const auto pollInterval = std::chrono::milliseconds(500);
+
+        struct timespec lastModified = modifiedTime();
+        while (running.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(pollInterval);
+
+            struct timespec modified = modifiedTime();
+            if ((modified.tv_sec == lastModified.tv_sec) && (modified.tv_nsec == lastModified.tv_nsec)) {
+                std::lock_guard<std::mutex> lock(reloadMutex);
+                reclaim();
+                continue;
+            }
+            lastModified = modified;
+
+            std::string error = reload();
+            if (error.empty()) std::cerr << "reloaded " << path << std::endl;
+            else std::cerr << "rejected " << path << ": " << error << std::endl;
+        }
+    }
+    struct timespec modifiedTime() const {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0) return {0, 0};
+        return status.st_mtim;
+    }
+};
+
+#endif //READY_TRADER_GO_2024_STRATEGY_PARAMS_H
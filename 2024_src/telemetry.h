@@ -0,0 +1,121 @@
+#ifndef READY_TRADER_GO_2024_TELEMETRY_H
+#define READY_TRADER_GO_2024_TELEMETRY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Live telemetry. After every message it handles, the trader copies a fixed layout snapshot into a shared memory
+ * segment, guarded by a seqlock, so a reader (see telemetry_reader.cc) can watch the trader live without touching the
+ * hot path or the disk.
+ * The writer never waits on the reader; the reader retries if it catches the writer mid-copy. */
+
+static constexpr const char *telemetrySegmentName = "/rtg_telemetry";
+static constexpr std::uint32_t telemetryLayoutVersion = 2;
+
+struct TelemetrySnapshot {
+    /* Everything here is plain numbers, so the layout is the same in the trader and the reader */
+    double time;
+    std::int64_t sequenceNumber;
+
+    // position and P&L, in lots and cents
+    std::int64_t etfPosition, futurePosition;
+    double networth;
+
+    // trading behaviour
+    std::int64_t lotsFilled, ordersSent, ordersCancelled;
+    std::int64_t liveOrders, submittedBids, submittedAsks;
+    double limiterUtilisation; // fraction of the per-second message budget used
+
+    // order book handler latency percentiles, in nanoseconds
+    std::int64_t latencyP50, latencyP90, latencyP99;
+
+    // current quotes
+    std::int64_t bidQuote, askQuote;
+
+    // from the analytics thread
+    double fairValueScore;
+};
+
+struct alignas(64) TelemetrySegment {
+    std::uint32_t layoutVersion;
+    std::atomic<std::uint64_t> sequence; // odd while the writer is mid-copy
+    TelemetrySnapshot snapshot;
+};
+
+class LatencyHistogram {
+    /* A histogram with power of two nanosecond buckets. Recording is a couple of instructions, and percentiles
+     * are accurate to within a factor of two, which is all we need to watch for regressions live */
+public:
+    void record(std::int64_t nanos) {
+        int bucket = nanos <= 1 ? 0 : 64 - __builtin_clzll((unsigned long long) nanos - 1);
+        buckets[std::min(bucket, bucketCount - 1)] ++;
+        total ++;
+    }
+    std::int64_t percentile(double p) const {
+        /* returns the upper bound of the bucket containing the given percentile */
+        if (total == 0) return 0;
+        std::uint64_t target = (std::uint64_t) (p * total), seen = 0;
+        for (int i = 0; i < bucketCount; i ++) {
+            seen += buckets[i];
+            if (seen > target) return (std::int64_t) 1 << i;
+        }
+        return (std::int64_t) 1 << (bucketCount - 1);
+    }
+private:
+    static constexpr int bucketCount = 40;
+    std::uint64_t buckets[bucketCount] = {};
+    std::uint64_t total = 0;
+};
+
+class TelemetryPublisher {
+    /* Owns the writer end of the telemetry segment. If the segment can't be created we carry on without it. */
+public:
+    TelemetryPublisher(bool useTelemetryIn): useTelemetry(useTelemetryIn) {
+        if (!useTelemetry) return;
+
+        int fd = shm_open(telemetrySegmentName, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) return;
+        if (ftruncate(fd, sizeof(TelemetrySegment)) != 0) {
+            close(fd);
+            return;
+        }
+        void *mapped = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) return;
+
+        segment = new (mapped) TelemetrySegment();
+        segment->layoutVersion = telemetryLayoutVersion;
+        segment->sequence.store(0, std::memory_order_release);
+    }
+    ~TelemetryPublisher() {
+        /* we're shutting down cleanly, so take the segment with us rather than leave a stale one for the reader */
+        if (segment == nullptr) return;
+        munmap(segment, sizeof(TelemetrySegment));
+        shm_unlink(telemetrySegmentName);
+    }
+    TelemetryPublisher(const TelemetryPublisher&) = delete;
+    TelemetryPublisher &operator=(const TelemetryPublisher&) = delete;
+
+    void publish(const TelemetrySnapshot &snapshot) {
+        /* copies the snapshot into the segment under the seqlock */
+        if (segment == nullptr) return;
+
+        std::uint64_t sequence = segment->sequence.load(std::memory_order_relaxed);
+        segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&segment->snapshot, &snapshot, sizeof(TelemetrySnapshot));
+        segment->sequence.store(sequence + 2, std::memory_order_release);
+    }
+private:
+    bool useTelemetry;
+    TelemetrySegment *segment = nullptr;
+};
+
+#endif //READY_TRADER_GO_2024_TELEMETRY_H
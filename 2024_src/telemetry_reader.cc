@@ -0,0 +1,65 @@
+//
+// Tails the trader's live telemetry segment, printing a line per update.
+// Usage: telemetry_reader [refresh interval in ms]
+//
+
+#include <iostream>
+#include <thread>
+#include "telemetry.h"
+
+static bool readSnapshot(const TelemetrySegment *segment, TelemetrySnapshot &snapshot, std::uint64_t &sequence) {
+    /* copies a consistent snapshot out of the segment, retrying if the writer was mid-copy */
+    for (int attempt = 0; attempt < 1000; attempt ++) {
+        std::uint64_t before = segment->sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        std::memcpy(&snapshot, &segment->snapshot, sizeof(TelemetrySnapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (segment->sequence.load(std::memory_order_relaxed) == before) {
+            sequence = before;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    long refreshMs = argc > 1 ? std::atol(argv[1]) : 500;
+
+    int fd = shm_open(telemetrySegmentName, O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "no telemetry segment at " << telemetrySegmentName << ", is the trader running?" << std::endl;
+        return 1;
+    }
+    void *mapped = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "failed to map the telemetry segment" << std::endl;
+        return 1;
+    }
+    const TelemetrySegment *segment = static_cast<const TelemetrySegment*>(mapped);
+    if (segment->layoutVersion != telemetryLayoutVersion) {
+        std::cerr << "telemetry layout version " << segment->layoutVersion << " doesn't match the reader's "
+                  << telemetryLayoutVersion << std::endl;
+        return 1;
+    }
+
+    std::cout << "time,seq,etfPosition,futurePosition,networth,lotsFilled,cancelRatio,liveOrders,submittedBids,"
+                 "submittedAsks,limiterUtilisation,p50ns,p90ns,p99ns,bid,ask,fairValueScore" << std::endl;
+    std::uint64_t lastSequence = 0;
+    while (true) {
+        TelemetrySnapshot s;
+        std::uint64_t sequence;
+        if (readSnapshot(segment, s, sequence) && (sequence != lastSequence)) {
+            lastSequence = sequence;
+            double cancelRatio = s.ordersSent == 0 ? 0 : (double) s.ordersCancelled / s.ordersSent;
+            std::cout << s.time << "," << s.sequenceNumber << "," << s.etfPosition << "," << s.futurePosition << ","
+                      << s.networth / 100.0 << "," << s.lotsFilled << "," << cancelRatio << "," << s.liveOrders << ","
+                      << s.submittedBids << "," << s.submittedAsks << "," << s.limiterUtilisation << ","
+                      << s.latencyP50 << "," << s.latencyP90 << "," << s.latencyP99 << ","
+                      << s.bidQuote << "," << s.askQuote << "," << s.fairValueScore << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(refreshMs));
+    }
+}
@@ -1,6 +1,9 @@
 #ifndef READY_TRADER_GO_2024_TYPES_H
 #define READY_TRADER_GO_2024_TYPES_H
 
+#include <cstddef>
+#include "checkpoint.h"
+
 struct Order {
     Instrument instrument;
     double time;
@@ -8,6 +11,7 @@ struct Order {
     unsigned long size;
     unsigned long price;
     Side side;
+    bool cancelling = false; // we've sent a cancel, but the exchange hasn't closed it yet
     Order() {};
     Order(unsigned long clientOrderIDIn, long sizeIn, long priceIn, ReadyTraderGo::Side sideIn, double timeIn, Instrument instrumentIn):
             clientOrderID(clientOrderIDIn), size(sizeIn), price(priceIn), side(sideIn), time(timeIn), instrument(instrumentIn) {};
@@ -31,6 +35,41 @@ struct ExchangeOrderBookData{
     }
 };
 
+struct Interval {
+    /* This class stores an interval of values, and has some basic operations */
+
+    double lower, upper; // lower and upper inclusive bounds
+
+    // constructors
+    Interval() {
+        lower = -1e9;
+        upper = 1e9;
+    }
+    Interval(double l, double u): lower(l), upper(u) {}
+
+    void print() {
+        std::cout << "[" << lower << ", " << upper << "]\n";
+    }
+
+    // updates the bounds of the interval.
+    // if lower > upper, we shift the interval so lower=upper
+    void setLowerBound(double bound) {
+        lower = std::max(bound, lower);
+        upper = std::max(upper, lower);
+    }
+    void setUpperBound(double bound) {
+        upper = std::min(upper, bound);
+        lower = std::min(upper, lower);
+    }
+
+    double getClosestToValue(double val) {
+        // returns the closest number in the interval to the given value
+        if (val < lower) return lower;
+        if (val > upper) return upper;
+        return val;
+    }
+};
+
 class Time {
     /* tracks the exchange's time, as we get orderbook data every 0.25s */
 private:
@@ -49,6 +88,35 @@ public:
         time += inc;
         return time;
     }
+    void save(CheckpointWriter &writer) const {
+        writer.write(time);
+    }
+    void load(CheckpointReader &reader) {
+        reader.read(time);
+    }
+};
+
+struct MemoryBudget {
+    /* Caps on how much history we hold in memory. A capacity of 0 keeps everything, which is fine for a 1000 second
+     * match, but for long sessions every history should be bounded so memory use stays constant.
+     * Bounded histories keep between capacity and 2 * capacity items, as we trim the oldest half at a time. */
+    std::size_t streamCapacity = 0; // data points per MarketStream
+    std::size_t bookCapacity = 0; // exchange order books per instrument
+    std::size_t filledOrdersCapacity = 0; // filled orders kept by the TradeMatcher
+    std::size_t unmatchedCapacity = 0; // unmatched fills per side before the oldest are merged
+
+    static MemoryBudget unbounded() {
+        return MemoryBudget();
+    }
+    static MemoryBudget bounded() {
+        // ~10 minutes of books, which is far more than any signal looks back
+        MemoryBudget budget;
+        budget.streamCapacity = 4 * 600;
+        budget.bookCapacity = 4 * 600;
+        budget.filledOrdersCapacity = 10000;
+        budget.unmatchedCapacity = 1000;
+        return budget;
+    }
 };
 
 #endif //READY_TRADER_GO_2024_TYPES_H
@@ -0,0 +1,191 @@
+//
+// Checks of the trader's building blocks that a replay can't catch, as it replays whatever they did live.
+// Usage: unit_checks
+// Builds with the trader, as journal_player does.
+// Prints each check that fails, and exits with 1 if any did.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <boost/asio/io_context.hpp>
+#include "rate_limiter.h"
+#include "replay.h"
+
+static int failures = 0;
+
+static void check(bool passed, const std::string &what) {
+    if (passed) return;
+    std::cerr << "FAILED: " << what << std::endl;
+    failures ++;
+}
+
+static void checkRateLimiter() {
+    /* N messages spread across a second all go, the N+1th inside the same second doesn't, and once the first
+     * message is a second old there's room again */
+    MessageFrequencyLimiter limiter;
+    limiter.setSpeed(1);
+    const long perSecond = limiter.getHeadroom();
+    const std::int64_t start = 5 * journalTicksPerSecond, spacing = journalTicksPerSecond / perSecond;
+
+    bool allSent = true;
+    for (long i = 0; i < perSecond; i++) allSent &= limiter.sendMessage(start + i * spacing);
+    check(allSent, "the rate limiter sends a full second's budget spread across the second");
+    check(limiter.getHeadroom() == 0, "the rate limiter has no headroom with its budget used");
+    check(limiter.getUtilisation() == 1, "the rate limiter is fully utilised with its budget used");
+    check(!limiter.sendMessage(start + journalTicksPerSecond - 1), "the rate limiter refuses one more inside the second");
+    check(limiter.getRefusals() == 1, "the rate limiter counts its refusal");
+    check(limiter.sendMessage(start + journalTicksPerSecond), "the rate limiter sends again once the first message is a second old");
+}
+
+static void checkRiskGateHedges() {
+    /* The lot cap and price band hold back orders that add to our exposure, but never a hedge that reduces it */
+    using namespace ReadyTraderGo;
+    RiskGate riskGate;
+    riskGate.setLimits(100, 200, 10, 500);
+    riskGate.setFairValue(100000);
+    riskGate.onSend(Instrument::ETF, Side::BUY, 10, 100000, 0);
+    riskGate.onFill(Instrument::ETF, Side::BUY, 10);
+
+    check(riskGate.getAllowedSize(Instrument::ETF, Side::BUY, 10, 1) <= 0, "the risk gate caps the lots we send in a second");
+    check(riskGate.reducesExposure(Instrument::FUTURE, Side::SELL, 10), "selling futures against a long ETF position is a hedge");
+    check(!riskGate.reducesExposure(Instrument::FUTURE, Side::SELL, 30), "selling more futures than we're long isn't");
+    check(!riskGate.reducesExposure(Instrument::FUTURE, Side::BUY, 10), "buying futures against a long ETF position isn't");
+    check(riskGate.getAllowedHedgeSize(Side::SELL, 10) == 10, "the lot cap doesn't hold back a hedge");
+    check(riskGate.getAllowedHedgeSize(Side::SELL, 150) == 100, "a hedge is still held to the futures position limit");
+}
+
+static void checkPartialHedgeFill() {
+    /* A hedge is fill and kill, so once it's filled, the lots that didn't fill mustn't still count against our
+     * futures headroom */
+    using namespace ReadyTraderGo;
+    SessionJournal::replaying() = true;
+    boost::asio::io_context context;
+    AutoTrader trader(context);
+    SessionJournal &journal = trader.getJournal();
+
+    // quote on a few books, a second apart so the rate limiter is never in the way
+    std::array<unsigned long, TOP_LEVEL_COUNT> askPrices, bidPrices, volumes;
+    for (int i = 0; i < TOP_LEVEL_COUNT; i++) {
+        askPrices[i] = 100100 + 100 * i;
+        bidPrices[i] = 99900 - 100 * i;
+        volumes[i] = 50;
+    }
+    std::int64_t now = 0;
+    for (unsigned long sequence = 1; sequence <= 10; sequence++) {
+        journal.setReplayTime(now += journalTicksPerSecond);
+        trader.OrderBookMessageHandler(Instrument::FUTURE, sequence, askPrices, volumes, bidPrices, volumes);
+        trader.OrderBookMessageHandler(Instrument::ETF, sequence, askPrices, volumes, bidPrices, volumes);
+    }
+    auto lastSent = [&](JournalEvent event) {
+        const std::vector<JournalRecord> &sent = journal.getReplayedOutbound();
+        for (auto record = sent.rbegin(); record != sent.rend(); record++)
+            if (record->event == event) return *record;
+        return JournalRecord{};
+    };
+    JournalRecord insert = lastSent(JournalEvent::InsertOrder);
+    check(insert.event == JournalEvent::InsertOrder, "the trader quotes the ETF");
+
+    // a fill on our quote makes us hedge
+    journal.setReplayTime(now += journalTicksPerSecond);
+    trader.OrderFilledMessageHandler(insert.id, insert.price, insert.volume);
+    JournalRecord hedge = lastSent(JournalEvent::HedgeOrder);
+    check((hedge.event == JournalEvent::HedgeOrder) && (hedge.volume > 1), "the trader hedges a fill");
+
+    // which only part fills
+    Side side = (Side) hedge.side;
+    long filled = (long) hedge.volume / 2;
+    journal.setReplayTime(now += journalTicksPerSecond);
+    trader.HedgeFilledMessageHandler(hedge.id, hedge.price, filled);
+    const RiskGate &riskGate = trader.getRiskGate();
+    long position = riskGate.getPosition(Instrument::FUTURE);
+    check(position == (side == Side::BUY ? filled : -filled), "a partial hedge fill moves our futures position by what filled");
+    long expected = TradingParameters::positionLimit + (side == Side::BUY ? -position : position);
+    check(riskGate.getHeadroom(Instrument::FUTURE, side) == expected, "a partial hedge fill leaves no futures volume open");
+    SessionJournal::replaying() = false;
+}
+
+static void checkRepeatedReplay() {
+    /* The Python bindings replay through a fresh trader each call, so two replays in one process must each stand alone,
+     * sending the same messages, with nothing left pointing into the first trader. Long enough for the metrics to print
+     * on disconnect */
+    using namespace ReadyTraderGo;
+    std::vector<JournalRecord> records;
+    std::int64_t now = 0;
+    long mid = 100000;
+    for (unsigned long sequence = 1; sequence <= 200; sequence++) {
+        mid += sequence % 3 == 0 ? 100 : -50;
+        for (Instrument instrument: {Instrument::FUTURE, Instrument::ETF}) {
+            JournalRecord record{};
+            record.index = records.size() + 1; // after the trader journals its starting parameters
+            record.timestamp = now += journalTicksPerSecond / 100;
+            record.event = JournalEvent::OrderBook;
+            record.instrument = (std::uint8_t) instrument;
+            record.id = sequence;
+            for (int i = 0; i < TOP_LEVEL_COUNT; i++) {
+                record.askPrices[i] = mid + 100 * (i + 1);
+                record.bidPrices[i] = mid - 100 * (i + 1);
+                record.askVolumes[i] = record.bidVolumes[i] = 20 + (sequence * (i + 3)) % 40;
+            }
+            records.push_back(record);
+        }
+    }
+    JournalRecord disconnect{};
+    disconnect.index = records.size() + 1;
+    disconnect.timestamp = now + 1;
+    disconnect.event = JournalEvent::Disconnect;
+    records.push_back(disconnect);
+
+    SessionJournal::replaying() = true;
+    std::vector<JournalRecord> outbound[2];
+    for (std::vector<JournalRecord> &sent: outbound) {
+        boost::asio::io_context context;
+        AutoTrader trader(context);
+        replayRecords(trader, records);
+        sent = trader.getJournal().getReplayedOutbound();
+    }
+    SessionJournal::replaying() = false;
+    check(!outbound[0].empty(), "a replay sends messages");
+    check(std::equal(outbound[0].begin(), outbound[0].end(), outbound[1].begin(), outbound[1].end(), sameMessage),
+          "a second replay in the same process sends the same messages as the first");
+}
+
+static void checkRestartRebase() {
+    /* A warm start after a reboot restores windows timed on the old clock. Rebased onto the new clock, whatever filled
+     * them still counts, until it's a second old on the new clock */
+    using namespace ReadyTraderGo;
+    const std::int64_t before = 1000 * journalTicksPerSecond, after = journalTicksPerSecond / 20;
+
+    MessageFrequencyLimiter limiter;
+    limiter.setSpeed(1);
+    const long perSecond = limiter.getHeadroom();
+    for (long i = 0; i < perSecond; i++) limiter.sendMessage(before + i * (journalTicksPerSecond / perSecond));
+    limiter.rebase(before + journalTicksPerSecond - 1, after);
+    check(!limiter.sendMessage(after), "the rate limiter's budget stays used across a restart");
+    check(limiter.sendMessage(after + 1), "the rate limiter sends again once the first message is a second old on the new clock");
+
+    RiskGate riskGate;
+    riskGate.setLimits(100, 200, 10, 500);
+    riskGate.onSend(Instrument::ETF, Side::BUY, 10, 100000, before);
+    riskGate.onFill(Instrument::ETF, Side::BUY, 10);
+    riskGate.rebase(before + 3 * RiskGate::bucketLength, after);
+    check(riskGate.getAllowedSize(Instrument::ETF, Side::BUY, 10, after) <= 0, "the lot cap stays used across a restart");
+    check(riskGate.getAllowedSize(Instrument::ETF, Side::BUY, 10, after + RiskGate::windowLength) == 10,
+          "the lot cap frees up once the lots are a second old on the new clock");
+}
+
+int main() {
+    checkRateLimiter();
+    checkRiskGateHedges();
+    checkPartialHedgeFill();
+    checkRepeatedReplay();
+    checkRestartRebase();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}